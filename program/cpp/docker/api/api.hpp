@@ -15,6 +15,7 @@
 #include "node3d.hpp"
 #include "syscalls_fwd.hpp"
 #include "timer.hpp"
+#include "channel.hpp"
 // Individual packed arrays
 #include "packed_byte_array.hpp"
 
@@ -258,12 +259,61 @@ inline bool is_part_of_tree(Node node) {
 }
 #endif
 
+/// @brief The return type of a public API function. Type-erased addresses (eg. void *)
+/// are assumed to return a Variant.
+template <typename F>
+struct sandbox_function_traits {
+	using return_type = Variant;
+};
+template <typename R, typename... Args>
+struct sandbox_function_traits<R(Args...)> {
+	using return_type = R;
+};
+template <typename R, typename... Args>
+struct sandbox_function_traits<R(Args...) noexcept> {
+	using return_type = R;
+};
+
+/// @brief Get the Variant type of a return value that is returned directly in registers.
+/// Functions returning Variant return it through memory, which is the default.
+template <typename R>
+static constexpr Variant::Type sandbox_unboxed_return_type() {
+	if constexpr (std::is_void_v<R>)
+		return Variant::NIL;
+	else if constexpr (std::is_same_v<R, bool>)
+		return Variant::BOOL;
+	else if constexpr (std::is_integral_v<R> || std::is_enum_v<R>)
+		return Variant::INT;
+	else if constexpr (std::is_same_v<R, double>)
+		return Variant::FLOAT;
+	else if constexpr (std::is_same_v<R, Vector2>)
+		return Variant::VECTOR2;
+	else if constexpr (std::is_same_v<R, Vector2i>)
+		return Variant::VECTOR2I;
+	else if constexpr (std::is_same_v<R, Vector3>)
+		return Variant::VECTOR3;
+	else if constexpr (std::is_same_v<R, Vector3i>)
+		return Variant::VECTOR3I;
+	else if constexpr (std::is_same_v<R, Vector4>)
+		return Variant::VECTOR4;
+	else if constexpr (std::is_same_v<R, Vector4i>)
+		return Variant::VECTOR4I;
+	else if constexpr (std::is_same_v<R, Color>)
+		return Variant::COLOR;
+	else if constexpr (std::is_base_of_v<Object, R>)
+		return Variant::OBJECT;
+	else
+		static_assert(!sizeof(R), "Unsupported return type for a public API function. Return a Variant instead.");
+}
+
 /// @brief Add a new public API function to the program during initialization.
 /// @param name  The name of the function. Eg. "my_function".
 /// @param address  The address of the function. Eg. my_function.
 /// @param return_type  The return type of the function. Eg. void, int, String, Dictionary, etc.
 /// @param args  The comma-separated arguments of the function. Eg. "int a, double b, String c"
 /// @param description  The description of the function. Can be empty.
+/// @note Functions that don't return a Variant return their value directly in registers,
+/// which avoids a round-trip through memory. Eg. int, double, bool, Vector2, Color and Objects.
 /// @example add_sandbox_api_function(
 ///    "add_numbers", (void *)add_numbers, "int", "int a, int b", "Adds two numbers together.");
 template <typename F>
@@ -284,7 +334,12 @@ static inline void add_sandbox_api_function(std::string_view name, F *address, s
 		.args = args.data(),
 		.args_len = args.size(),
 	};
-	sys_sandbox_add(1, name.data(), name.size(), address, &extra);
+	using R = typename sandbox_function_traits<F>::return_type;
+	if constexpr (std::is_same_v<R, Variant>) {
+		sys_sandbox_add(1, name.data(), name.size(), address, &extra);
+	} else {
+		sys_sandbox_add(3, name.data(), name.size(), address, &extra, sandbox_unboxed_return_type<R>());
+	}
 }
 #define ADD_API_FUNCTION(func, return_type, ...) \
 	add_sandbox_api_function(#func, func, return_type, ##__VA_ARGS__)
@@ -3,6 +3,7 @@
 #include "syscalls.h"
 
 MAKE_SYSCALL(ECALL_ARRAY_OPS, void, sys_array_ops, Array_Op, unsigned, int, Variant *);
+MAKE_SYSCALL(ECALL_ARRAY_OPS, unsigned, sys_array_range_ops, Array_Op, unsigned, int, const Variant *, unsigned);
 MAKE_SYSCALL(ECALL_ARRAY_AT, void, sys_array_at, unsigned, int, Variant *);
 MAKE_SYSCALL(ECALL_ARRAY_SIZE, int, sys_array_size, unsigned);
 EXTERN_SYSCALL(unsigned, sys_vassign, unsigned, unsigned);
@@ -85,6 +86,17 @@ std::vector<Variant> Array::to_vector() const {
 	return result;
 }
 
+unsigned Array::get_range(int start, std::span<Variant> buffer) const {
+	return sys_array_range_ops(Array_Op::GET_RANGE, m_idx, start, buffer.data(), buffer.size());
+}
+
+void Array::set_range(int start, std::span<const Variant> values) {
+	sys_array_range_ops(Array_Op::SET_RANGE, m_idx, start, values.data(), values.size());
+}
+
+void Array::append_range(std::span<const Variant> values) {
+	sys_array_range_ops(Array_Op::APPEND_RANGE, m_idx, 0, values.data(), values.size());
+}
 
 ArrayProxy &ArrayProxy::operator=(const Variant &value) { // set
 	const int set_idx = -this->m_idx - 1;
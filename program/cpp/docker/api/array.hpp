@@ -37,6 +37,21 @@ struct Array {
 
 	std::vector<Variant> to_vector() const;
 
+	/// @brief Copy a range of elements into a buffer, in a single call.
+	/// Primitive elements are copied by value, and complex elements are references to the originals.
+	/// @param start The index of the first element.
+	/// @param buffer The buffer to fill.
+	/// @return The number of elements copied, which is less than the buffer size at the end of the Array,
+	/// or when the call runs out of references.
+	unsigned get_range(int start, std::span<Variant> buffer) const;
+	/// @brief Assign a range of elements, in a single call. The range must be within the Array.
+	/// @param start The index of the first element.
+	/// @param values The new elements.
+	void set_range(int start, std::span<const Variant> values);
+	/// @brief Append elements to the end of the Array, in a single call.
+	/// @param values The elements to append.
+	void append_range(std::span<const Variant> values);
+
 	// Array size
 	int size() const;
 	bool is_empty() const { return size() == 0; }
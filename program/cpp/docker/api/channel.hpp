@@ -0,0 +1,96 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include "syscalls.h"
+
+/**
+ * @brief A ring buffer in memory shared with the host, opened with Sandbox.open_channel().
+ * Messages are passed without any system calls, with one producer and one consumer.
+ * The host passes the address of the channel to the guest, eg. as a function argument.
+ */
+struct Channel {
+	/// @brief Access a channel opened by the host.
+	/// @param address The guest address of the channel.
+	explicit Channel(uint64_t address) : m_base(reinterpret_cast<uint8_t *>(address)) {}
+
+	/// @brief Send a message to the host, with the guest as the producer.
+	/// @param data The message data.
+	/// @param size The size of the message in bytes.
+	/// @return True if the message was sent, false if the channel is full.
+	bool send(const void *data, uint32_t size);
+	bool send(std::string_view message) { return send(message.data(), message.size()); }
+
+	/// @brief Receive the next message from the host, with the guest as the consumer.
+	/// @param buffer The buffer to receive the message into.
+	/// @param size The size of the buffer in bytes.
+	/// @return The size of the message, or -1 if the channel is empty. If the message
+	/// is larger than the buffer, it is left in the channel and only its size is returned.
+	int64_t receive(void *buffer, uint32_t size);
+
+	/// @brief Check if there are no messages waiting in the channel.
+	bool is_empty() const { return load(Channel_Layout::HEAD) == load(Channel_Layout::TAIL); }
+
+	/// @brief The size of the ring buffer in bytes.
+	uint32_t capacity() const { return *reinterpret_cast<const uint32_t *>(m_base + int(Channel_Layout::CAPACITY)); }
+
+private:
+	uint64_t load(Channel_Layout counter, int order = __ATOMIC_ACQUIRE) const {
+		return __atomic_load_n(reinterpret_cast<const uint64_t *>(m_base + int(counter)), order);
+	}
+	void store(Channel_Layout counter, uint64_t value) {
+		__atomic_store_n(reinterpret_cast<uint64_t *>(m_base + int(counter)), value, __ATOMIC_RELEASE);
+	}
+	// Copy into or out of the ring buffer, wrapping around at the end
+	void write(uint64_t position, const void *src, uint32_t size);
+	void read(uint64_t position, void *dst, uint32_t size) const;
+
+	uint8_t *m_base;
+};
+
+inline void Channel::write(uint64_t position, const void *src, uint32_t size) {
+	uint8_t *data = m_base + int(Channel_Layout::DATA);
+	const uint32_t offset = position & (capacity() - 1);
+	const uint32_t first = std::min(size, capacity() - offset);
+	std::memcpy(data + offset, src, first);
+	std::memcpy(data, static_cast<const uint8_t *>(src) + first, size - first);
+}
+
+inline void Channel::read(uint64_t position, void *dst, uint32_t size) const {
+	const uint8_t *data = m_base + int(Channel_Layout::DATA);
+	const uint32_t offset = position & (capacity() - 1);
+	const uint32_t first = std::min(size, capacity() - offset);
+	std::memcpy(dst, data + offset, first);
+	std::memcpy(static_cast<uint8_t *>(dst) + first, data, size - first);
+}
+
+inline bool Channel::send(const void *data, uint32_t size) {
+	// The length and payload, padded so that lengths never wrap around the end
+	const uint64_t needed = sizeof(uint32_t) + ((uint64_t(size) + 3) & ~uint64_t(3));
+	const uint64_t head = load(Channel_Layout::HEAD, __ATOMIC_RELAXED);
+	const uint64_t tail = load(Channel_Layout::TAIL);
+	if (capacity() - (head - tail) < needed) {
+		return false;
+	}
+	write(head, &size, sizeof(size));
+	write(head + sizeof(size), data, size);
+	store(Channel_Layout::HEAD, head + needed);
+	return true;
+}
+
+inline int64_t Channel::receive(void *buffer, uint32_t size) {
+	const uint64_t tail = load(Channel_Layout::TAIL, __ATOMIC_RELAXED);
+	const uint64_t head = load(Channel_Layout::HEAD);
+	if (head == tail) {
+		return -1;
+	}
+	uint32_t message_size;
+	read(tail, &message_size, sizeof(message_size));
+	if (message_size > size) {
+		return message_size;
+	}
+	read(tail + sizeof(message_size), buffer, message_size);
+	store(Channel_Layout::TAIL, tail + sizeof(uint32_t) + ((uint64_t(message_size) + 3) & ~uint64_t(3)));
+	return message_size;
+}
@@ -27,6 +27,18 @@ int Dictionary::size() const {
 	return sys_dict_ops(Dictionary_Op::GET_SIZE, m_idx);
 }
 
+unsigned Dictionary::get_keys(int start, std::span<Variant> buffer) const {
+	return sys_dict_ops(Dictionary_Op::GET_KEYS, m_idx, buffer.data(), buffer.size(), start);
+}
+
+unsigned Dictionary::get_values(int start, std::span<Variant> buffer) const {
+	return sys_dict_ops(Dictionary_Op::GET_VALUES, m_idx, buffer.data(), buffer.size(), start);
+}
+
+unsigned Dictionary::get_items(int start, std::span<Variant> buffer) const {
+	return sys_dict_ops(Dictionary_Op::GET_ITEMS, m_idx, buffer.data(), buffer.size(), start);
+}
+
 Variant Dictionary::get(const Variant &key) const {
 	Variant v;
 	(void)sys_dict_ops(Dictionary_Op::GET, m_idx, &key, &v);
@@ -33,6 +33,24 @@ struct Dictionary {
 	bool recursive_equal(const Dictionary &dictionary, int recursion_count) const;
 	Variant values() const;
 
+	/// @brief Copy a range of the keys into a buffer, in a single call.
+	/// Primitive keys are copied by value, and complex keys are references to the originals.
+	/// Copying stops early at the end of the Dictionary, or when the call runs out of references.
+	/// @param start The index of the first entry.
+	/// @param buffer The buffer to fill.
+	/// @return The number of keys copied.
+	unsigned get_keys(int start, std::span<Variant> buffer) const;
+	/// @brief Copy a range of the values into a buffer, in a single call.
+	/// @param start The index of the first entry.
+	/// @param buffer The buffer to fill.
+	/// @return The number of values copied.
+	unsigned get_values(int start, std::span<Variant> buffer) const;
+	/// @brief Copy a range of the keys and values into a buffer, in a single call.
+	/// @param start The index of the first entry.
+	/// @param buffer The buffer to fill, with each key followed by its value.
+	/// @return The number of key-value pairs copied.
+	unsigned get_items(int start, std::span<Variant> buffer) const;
+
 	// Call methods on the Dictionary
 	template <typename... Args>
 	Variant operator () (std::string_view method, Args&&... args);
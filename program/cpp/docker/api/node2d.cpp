@@ -5,6 +5,7 @@
 
 // API call to get/set Node2D properties.
 MAKE_SYSCALL(ECALL_NODE2D, void, sys_node2d, Node2D_Op, uint64_t, Variant *);
+MAKE_SYSCALL(ECALL_NODE_TRANSFORMS, void, sys_node_transforms, Node_Transforms_Op, const uint64_t *, real_t *, size_t);
 EXTERN_SYSCALL(void, sys_node, Node_Op, uint64_t, Variant *);
 EXTERN_SYSCALL(uint64_t, sys_node_create, Node_Create_Shortlist, const char *, size_t, const char *, size_t);
 
@@ -23,6 +24,11 @@ void Node2D::set_position(const Vector2 &position) {
 	node2d(Node2D_Op::SET_POSITION, address(), value);
 }
 
+void Node2D::set_position_immediate(const Vector2 &position) {
+	Variant value(position);
+	node2d(Node2D_Op::SET_POSITION_IMMEDIATE, address(), value);
+}
+
 float Node2D::get_rotation() const {
 	Variant var;
 	node2d(Node2D_Op::GET_ROTATION, address(), var);
@@ -66,6 +72,17 @@ Transform2D Node2D::get_transform() const {
 	return var.as_transform2d();
 }
 
+// The nodes are passed to the host as an array of addresses.
+static_assert(sizeof(Node2D) == sizeof(uint64_t));
+
+void Node2D::get_transforms(std::span<const Node2D> nodes, real_t *transforms) {
+	sys_node_transforms(Node_Transforms_Op::GET_TRANSFORMS_2D, reinterpret_cast<const uint64_t *>(nodes.data()), transforms, nodes.size());
+}
+
+void Node2D::set_transforms(std::span<const Node2D> nodes, const real_t *transforms) {
+	sys_node_transforms(Node_Transforms_Op::SET_TRANSFORMS_2D, reinterpret_cast<const uint64_t *>(nodes.data()), const_cast<real_t *>(transforms), nodes.size());
+}
+
 Node2D Node2D::duplicate(int flags) const {
 	return Node::duplicate(flags);
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "canvas_item.hpp"
+#include <span>
 struct Transform2D;
 
 // Node2D: Contains 2D transformations.
@@ -18,9 +19,12 @@ struct Node2D : public CanvasItem {
 	/// @brief Get the position of the node.
 	/// @return The position of the node.
 	Vector2 get_position() const;
-	/// @brief Set the position of the node.
+	/// @brief Set the position of the node, deferred until idle time.
 	/// @param value The new position of the node.
 	void set_position(const Vector2 &value);
+	/// @brief Set the position of the node immediately.
+	/// @param value The new position of the node.
+	void set_position_immediate(const Vector2 &value);
 
 	/// @brief Get the rotation of the node.
 	/// @return The rotation of the node.
@@ -51,6 +55,16 @@ struct Node2D : public CanvasItem {
 	/// @return The 2D transform of the node.
 	Transform2D get_transform() const;
 
+	/// @brief Get the 2D transforms of many nodes in a single call.
+	/// @param nodes The Node2D nodes.
+	/// @param transforms 6 reals per node: the x and y axes, followed by the origin.
+	static void get_transforms(std::span<const Node2D> nodes, real_t *transforms);
+
+	/// @brief Set the 2D transforms of many nodes in a single call.
+	/// @param nodes The Node2D nodes.
+	/// @param transforms 6 reals per node: the x and y axes, followed by the origin.
+	static void set_transforms(std::span<const Node2D> nodes, const real_t *transforms);
+
 	/// @brief  Duplicate the node.
 	/// @return A new Node2D with the same properties and children.
 	Node2D duplicate(int flags = 15) const;
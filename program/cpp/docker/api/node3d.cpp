@@ -6,6 +6,7 @@
 
 // API call to get/set Node3D properties.
 MAKE_SYSCALL(ECALL_NODE3D, void, sys_node3d, Node3D_Op, uint64_t, Variant *);
+EXTERN_SYSCALL(void, sys_node_transforms, Node_Transforms_Op, const uint64_t *, real_t *, size_t);
 EXTERN_SYSCALL(void, sys_node, Node_Op, uint64_t, Variant *);
 EXTERN_SYSCALL(uint64_t, sys_node_create, Node_Create_Shortlist, const char *, size_t, const char *, size_t);
 
@@ -43,6 +44,17 @@ void Node3D::set_scale(const Variant &value) {
 	node3d(Node3D_Op::SET_SCALE, address(), value);
 }
 
+// The nodes are passed to the host as an array of addresses.
+static_assert(sizeof(Node3D) == sizeof(uint64_t));
+
+void Node3D::get_transforms(std::span<const Node3D> nodes, real_t *transforms) {
+	sys_node_transforms(Node_Transforms_Op::GET_TRANSFORMS_3D, reinterpret_cast<const uint64_t *>(nodes.data()), transforms, nodes.size());
+}
+
+void Node3D::set_transforms(std::span<const Node3D> nodes, const real_t *transforms) {
+	sys_node_transforms(Node_Transforms_Op::SET_TRANSFORMS_3D, reinterpret_cast<const uint64_t *>(nodes.data()), const_cast<real_t *>(transforms), nodes.size());
+}
+
 Node3D Node3D::duplicate(int flags) const {
 	return Node::duplicate(flags);
 }
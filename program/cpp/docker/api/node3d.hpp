@@ -1,5 +1,6 @@
 #pragma once
 #include "node.hpp"
+#include <span>
 struct Transform3D;
 struct Quaternion;
 
@@ -53,6 +54,16 @@ struct Node3D : public Node {
 	/// @return The rotation of the node as a Quaternion.
 	Quaternion get_quaternion() const;
 
+	/// @brief Get the 3D transforms of many nodes in a single call.
+	/// @param nodes The Node3D nodes.
+	/// @param transforms 12 reals per node: the three basis rows, followed by the origin.
+	static void get_transforms(std::span<const Node3D> nodes, real_t *transforms);
+
+	/// @brief Set the 3D transforms of many nodes in a single call.
+	/// @param nodes The Node3D nodes.
+	/// @param transforms 12 reals per node: the three basis rows, followed by the origin.
+	static void set_transforms(std::span<const Node3D> nodes, const real_t *transforms);
+
 	/// @brief  Duplicate the node.
 	/// @return A new Node3D object with the same properties and children.
 	Node3D duplicate(int flags = 15) const;
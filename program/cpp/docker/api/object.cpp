@@ -7,6 +7,9 @@
 MAKE_SYSCALL(ECALL_GET_OBJ, uint64_t, sys_get_obj, const char *, size_t);
 MAKE_SYSCALL(ECALL_OBJ, void, sys_obj, Object_Op, uint64_t, Variant *);
 MAKE_SYSCALL(ECALL_OBJ_CALLP, void, sys_obj_callp, uint64_t, const char *, size_t, bool, Variant *, const Variant *, unsigned);
+MAKE_SYSCALL(ECALL_OBJ_METHOD, uint32_t, sys_obj_method_resolve, Object_Method_Op, uint64_t, const char *, size_t);
+MAKE_SYSCALL(ECALL_OBJ_METHOD, void, sys_obj_method_call, Object_Method_Op, uint64_t, uint32_t, Variant *, const Variant *, unsigned);
+MAKE_SYSCALL(ECALL_INTERN_NAME, uint32_t, sys_intern_name, const char *, size_t);
 MAKE_SYSCALL(ECALL_OBJ_PROP_GET, void, sys_obj_property_get, uint64_t, const char *, size_t, Variant *);
 MAKE_SYSCALL(ECALL_OBJ_PROP_SET, void, sys_obj_property_set, uint64_t, const char *, size_t, const Variant *);
 
@@ -16,6 +19,41 @@ Object::Object(const std::string &name) :
 		m_address{ sys_get_obj(name.c_str(), name.size()) } {
 }
 
+InternedName::InternedName(std::string_view name) :
+		id{ sys_intern_name(name.data(), name.size()) } {
+}
+
+// Interned names are passed as a null name, with the handle in place of the length.
+Variant Object::callv(InternedName method, bool deferred, const Variant *argv, unsigned argc) {
+	Variant var;
+	sys_obj_callp(address(), nullptr, method.id, deferred, &var, argv, argc);
+	return var;
+}
+
+void Object::voidcallv(InternedName method, bool deferred, const Variant *argv, unsigned argc) {
+	sys_obj_callp(address(), nullptr, method.id, deferred, nullptr, argv, argc);
+}
+
+Variant Object::get(InternedName name) const {
+	Variant var;
+	sys_obj_property_get(address(), nullptr, name.id, &var);
+	return var;
+}
+
+void Object::set(InternedName name, const Variant &value) {
+	sys_obj_property_set(address(), nullptr, name.id, &value);
+}
+
+MethodHandle Object::resolve_method(std::string_view method) const {
+	return MethodHandle{ sys_obj_method_resolve(Object_Method_Op::RESOLVE, address(), method.data(), method.size()) };
+}
+
+Variant Object::callv(MethodHandle method, const Variant *argv, unsigned argc) {
+	Variant var;
+	sys_obj_method_call(Object_Method_Op::CALL, address(), method.id, &var, argv, argc);
+	return var;
+}
+
 std::vector<std::string> Object::get_method_list() const {
 	if constexpr (sizeof(std::string) == 32) {
 		std::vector<std::string> methods;
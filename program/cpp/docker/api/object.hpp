@@ -3,6 +3,24 @@
 #include "string.hpp"
 #include "syscalls_fwd.hpp"
 
+/// @brief A method or property name interned by the host. It can be passed to calls and
+/// property accesses instead of a string, which avoids interning the name on every use.
+/// @note Keep interned names in static storage, eg. `static const InternedName name("set_position");`
+struct InternedName {
+	/// @brief Intern a name. Interning the same name again gives the same handle.
+	/// @param name The method or property name.
+	explicit InternedName(std::string_view name);
+
+	uint32_t id = 0;
+};
+
+/// @brief An opaque handle to a resolved method, see Object::resolve_method().
+struct MethodHandle {
+	uint32_t id = 0;
+
+	constexpr bool is_valid() const { return id != 0; }
+};
+
 struct Object {
 	/// @brief Construct an Object object from an allowed global object.
 	explicit Object(const std::string &name);
@@ -24,6 +42,36 @@ struct Object {
 	/// @param args The arguments to pass to the method.
 	void voidcallv(std::string_view method, bool deferred, const Variant *argv, unsigned argc);
 
+	/// @brief Resolve a method into a handle, which can be reused for calls on objects of the same class,
+	/// or of a class that inherits it. Calls on objects of other classes throw.
+	/// Calling through a handle avoids passing and looking up the method name on every call.
+	/// @param method The method to resolve.
+	/// @return The method handle. Throws if the method does not exist.
+	MethodHandle resolve_method(std::string_view method) const;
+
+	/// Call a method on the node, using a resolved method handle.
+	/// @param method The method handle, from resolve_method().
+	/// @param args The arguments to pass to the method.
+	/// @return The return value of the method.
+	Variant callv(MethodHandle method, const Variant *argv, unsigned argc);
+
+	template <typename... Args>
+	Variant call(MethodHandle method, Args... args);
+
+	/// Call a method on the node, using an interned method name.
+	/// @param method The interned method name.
+	/// @param deferred If true, the method will be called next frame.
+	/// @param args The arguments to pass to the method.
+	/// @return The return value of the method.
+	Variant callv(InternedName method, bool deferred, const Variant *argv, unsigned argc);
+	void voidcallv(InternedName method, bool deferred, const Variant *argv, unsigned argc);
+
+	template <typename... Args>
+	Variant call(InternedName method, Args... args);
+
+	template <typename... Args>
+	void voidcall(InternedName method, Args... args);
+
 	template <typename... Args>
 	Variant call(std::string_view method, Args... args);
 
@@ -47,11 +95,13 @@ struct Object {
 	/// @param name The name of the property.
 	/// @return The value of the property.
 	Variant get(std::string_view name) const;
+	Variant get(InternedName name) const;
 
 	/// @brief Set a property of the object.
 	/// @param name The name of the property.
 	/// @param value The value to set the property to.
 	void set(std::string_view name, const Variant &value);
+	void set(InternedName name, const Variant &value);
 
 	/// @brief Assign a value to a property of the object, at the end of the frame.
 	/// @param property The name of the property.
@@ -182,6 +232,24 @@ inline Variant::Variant(const Object &obj) {
 	v.i = obj.address();
 }
 
+template <typename... Args>
+inline Variant Object::call(MethodHandle method, Args... args) {
+	Variant argv[] = {args...};
+	return callv(method, argv, sizeof...(Args));
+}
+
+template <typename... Args>
+inline Variant Object::call(InternedName method, Args... args) {
+	Variant argv[] = {args...};
+	return callv(method, false, argv, sizeof...(Args));
+}
+
+template <typename... Args>
+inline void Object::voidcall(InternedName method, Args... args) {
+	Variant argv[] = {args...};
+	this->voidcallv(method, false, argv, sizeof...(Args));
+}
+
 template <typename... Args>
 inline Variant Object::call(std::string_view method, Args... args) {
 	Variant argv[] = {args...};
@@ -264,12 +332,12 @@ inline void Object::connect(const std::string &signal, Callable method) {
 	this->call("connect", signal, method);
 }
 
-template <typename T, typename P = Variant>
+template <typename T, typename P = Variant, typename N = std::string_view>
 struct PropertyProxy {
 	const T &obj;
-	const std::string_view property;
+	const N property;
 
-	constexpr PropertyProxy(const T &obj, std::string_view property)
+	constexpr PropertyProxy(const T &obj, N property)
 			: obj(obj), property(property) {}
 
 	PropertyProxy &operator=(const P &v) {
@@ -289,6 +357,23 @@ struct PropertyProxy {
 	auto name() { return PropertyProxy<decltype(*this), Type>(*this, #name); } \
 	auto name() const { return PropertyProxy<decltype(*this), Type>(*this, #name); }
 
+// Like PROPERTY(), but the property name is interned on first use.
+#define INTERNED_PROPERTY(name, Type)      \
+	auto name() { static const InternedName interned(#name); return PropertyProxy<decltype(*this), Type, InternedName>(*this, interned); } \
+	auto name() const { static const InternedName interned(#name); return PropertyProxy<decltype(*this), Type, InternedName>(*this, interned); }
+
+// Like METHOD(), but the method name is interned on first use.
+#define INTERNED_METHOD(Type, name) \
+	template <typename... Args> \
+	inline Type name(Args&&... args) { \
+		static const InternedName interned(#name); \
+		if constexpr (std::is_same_v<Type, void>) { \
+			voidcall(interned, std::forward<Args>(args)...); \
+		} else { \
+			return call(interned, std::forward<Args>(args)...); \
+		} \
+	}
+
 #define CUSTOM_PROPERTY(name, Type, getter, setter)      \
 	auto name() { return PropertyProxy(*this, #name); } \
 	auto name() const { return PropertyProxy(*this, #name); } \
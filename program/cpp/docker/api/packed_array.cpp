@@ -205,6 +205,52 @@ std::vector<std::string> PackedArray<std::string>::fetch() const {
 	return result;
 }
 
+template <typename T>
+static std::span<const T> view_packed_array(unsigned idx) {
+	struct Buffer {
+		const T *ptr;
+		size_t size; // In bytes
+	} buffer;
+	sys_vfetch(idx, &buffer, 3);
+	return { buffer.ptr, buffer.size / sizeof(T) };
+}
+template <>
+std::span<const uint8_t> PackedArray<uint8_t>::view() const {
+	return view_packed_array<uint8_t>(m_idx);
+}
+template <>
+std::span<const int32_t> PackedArray<int32_t>::view() const {
+	return view_packed_array<int32_t>(m_idx);
+}
+template <>
+std::span<const int64_t> PackedArray<int64_t>::view() const {
+	return view_packed_array<int64_t>(m_idx);
+}
+template <>
+std::span<const float> PackedArray<float>::view() const {
+	return view_packed_array<float>(m_idx);
+}
+template <>
+std::span<const double> PackedArray<double>::view() const {
+	return view_packed_array<double>(m_idx);
+}
+template <>
+std::span<const Vector2> PackedArray<Vector2>::view() const {
+	return view_packed_array<Vector2>(m_idx);
+}
+template <>
+std::span<const Vector3> PackedArray<Vector3>::view() const {
+	return view_packed_array<Vector3>(m_idx);
+}
+template <>
+std::span<const Vector4> PackedArray<Vector4>::view() const {
+	return view_packed_array<Vector4>(m_idx);
+}
+template <>
+std::span<const Color> PackedArray<Color>::view() const {
+	return view_packed_array<Color>(m_idx);
+}
+
 template <>
 void PackedArray<uint8_t>::store(const std::vector<uint8_t> &data) {
 	sys_vstore(&m_idx, Variant::PACKED_BYTE_ARRAY, data.data(), data.size());
@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include <span>
 #include <vector>
 #include "color.hpp"
 #include "vector.hpp"
@@ -50,6 +51,12 @@ struct PackedArray {
 	/// @return std::vector<T> The host-side array data.
 	std::vector<T> fetch() const;
 
+	/// @brief View the host-side array data without copying it.
+	/// The data is mapped read-only into the guest, and the view is valid until
+	/// the current VM call returns. Not available for PackedStringArray.
+	/// @return std::span<const T> The host-side array data.
+	std::span<const T> view() const;
+
 	/// @brief Store a vector of data into the host-side array.
 	/// @param data The data to store.
 	void store(const std::vector<T> &data);
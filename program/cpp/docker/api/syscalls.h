@@ -70,7 +70,15 @@
 
 #define ECALL_PACKED_ARRAY_OPS (GAME_API_BASE + 48)
 
-#define ECALL_LAST (GAME_API_BASE + 49)
+#define ECALL_VFREE (GAME_API_BASE + 49) // Free a permanent Variant
+
+#define ECALL_NODE_TRANSFORMS (GAME_API_BASE + 50) // Get/set the transforms of many nodes
+
+#define ECALL_OBJ_METHOD (GAME_API_BASE + 51) // Resolve and call method handles
+
+#define ECALL_INTERN_NAME (GAME_API_BASE + 52) // Intern a method or property name
+
+#define ECALL_LAST (GAME_API_BASE + 53)
 
 #define STRINGIFY_HELPER(x) #x
 #define STRINGIFY(x) STRINGIFY_HELPER(x)
@@ -99,6 +107,11 @@ enum class Object_Op {
 	GET_SIGNAL_LIST,
 };
 
+enum class Object_Method_Op {
+	RESOLVE = 0,
+	CALL,
+};
+
 enum class Node_Create_Shortlist {
 	CREATE_CLASSDB = 0,
 	CREATE_NODE,
@@ -142,6 +155,7 @@ enum class Node2D_Op {
 	SET_SKEW,
 	GET_TRANSFORM,
 	SET_TRANSFORM,
+	SET_POSITION_IMMEDIATE, // SET_POSITION is deferred until idle time
 };
 
 enum class Node3D_Op {
@@ -157,6 +171,16 @@ enum class Node3D_Op {
 	SET_QUATERNION,
 };
 
+// Transforms are passed as raw real_t arrays, one transform per node:
+// 2D: 6 reals, the x and y axes followed by the origin.
+// 3D: 12 reals, the three basis rows followed by the origin.
+enum class Node_Transforms_Op {
+	GET_TRANSFORMS_2D = 0,
+	SET_TRANSFORMS_2D,
+	GET_TRANSFORMS_3D,
+	SET_TRANSFORMS_3D,
+};
+
 enum class Array_Op {
 	CREATE = 0,
 	PUSH_BACK,
@@ -171,6 +195,9 @@ enum class Array_Op {
 	SORT,
 	FETCH_TO_VECTOR,
 	HAS,
+	GET_RANGE, // Copy a range of elements into a guest buffer, count in A4
+	SET_RANGE, // Assign a range of elements from a guest buffer, count in A4
+	APPEND_RANGE, // Append elements from a guest buffer, count in A4
 };
 
 enum class Dictionary_Op {
@@ -184,6 +211,7 @@ enum class Dictionary_Op {
 	CLEAR,
 	MERGE,
 	GET_OR_ADD,
+	GET_ITEMS, // Copy keys and values, interleaved, into a guest buffer, first entry in A4
 };
 
 enum class String_Op {
@@ -329,3 +357,12 @@ enum class Quaternion_Op {
 	GET_ANGLE,
 	MUL,
 };
+
+// Layout of a shared memory channel: a single-producer single-consumer ring buffer.
+// Each message is a 32-bit length followed by the payload, padded to 4 bytes.
+enum class Channel_Layout {
+	CAPACITY = 0, // uint32_t size of the data area, a power of two
+	HEAD = 64, // uint64_t total bytes written, advanced only by the producer
+	TAIL = 128, // uint64_t total bytes read, advanced only by the consumer
+	DATA = 256, // Start of the data area
+};
@@ -11,6 +11,7 @@ MAKE_SYSCALL(ECALL_VCREATE, void, sys_vcreate, Variant *, int, int, ...);
 MAKE_SYSCALL(ECALL_VFETCH, void, sys_vfetch, unsigned, void *, int);
 MAKE_SYSCALL(ECALL_VCLONE, void, sys_vclone, const Variant *, Variant *);
 MAKE_SYSCALL(ECALL_VSTORE, void, sys_vstore, unsigned *, const void *, size_t);
+MAKE_SYSCALL(ECALL_VFREE, void, sys_vfree, Variant *);
 
 MAKE_SYSCALL(ECALL_CALLABLE_CREATE, unsigned, sys_callable_create, void (*)(), const Variant *, const void *, size_t);
 
@@ -99,6 +100,10 @@ Variant &Variant::make_permanent() {
 	return *this;
 }
 
+void Variant::free_permanent() {
+	sys_vfree(this);
+}
+
 bool Variant::is_permanent() const noexcept {
 	return int32_t(uint32_t(this->v.i)) < 0;
 }
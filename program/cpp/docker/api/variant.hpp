@@ -287,6 +287,9 @@ struct Variant
 	/// @brief Make the Variant permanent, by moving it to permanent storage.
 	/// @return Updates the Variant to the new permanent Variant and returns it.
 	Variant &make_permanent();
+	/// @brief Free the permanent storage of the Variant, so that it can be reused.
+	/// The Variant becomes Nil, and other copies of it become invalid.
+	void free_permanent();
 	bool is_permanent() const noexcept;
 
 	Variant &operator=(const Variant &other);
@@ -3,6 +3,32 @@ use core::arch::asm;
 use core::ffi::c_char;
 use crate::godot::variant::Variant;
 
+/* A method or property name interned by the host, which can be passed
+   instead of a string to avoid interning the name on every call. */
+#[derive(Clone, Copy)]
+pub struct InternedName
+{
+	id: u32,
+}
+
+impl InternedName
+{
+	pub fn new(name: &str) -> InternedName
+	{
+		const SYSCALL_INTERN_NAME: i32 = 552;
+		let id: u32;
+		unsafe {
+			asm!("ecall",
+				in("a0") name.as_ptr(),
+				in("a1") name.len(),
+				in("a7") SYSCALL_INTERN_NAME,
+				lateout("a0") id,
+				options(nostack));
+		}
+		InternedName { id: id }
+	}
+}
+
 pub struct Node
 {
 	address: usize,
@@ -40,6 +66,12 @@ impl Node
 		let address = self.address;
 		return godot_method_call(address, method.as_ptr(), method.len(), args.as_ptr(), args.len());
 	}
+
+	pub fn call_interned(&self, method: InternedName, args: &[Variant]) -> Variant
+	{
+		// Interned names are passed as a null name, with the handle in place of the length
+		return godot_method_call(self.address, core::ptr::null(), method.id as usize, args.as_ptr(), args.len());
+	}
 }
 
 fn godot_node_get(parent_address: usize, path: *const c_char, size: usize) -> usize
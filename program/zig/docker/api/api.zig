@@ -3,6 +3,19 @@
 //
 pub const V = union { b: bool, i: i64, f: f64, obj: u64, bytes: [16]u8 };
 pub extern fn sys_vcall(self: *Variant, method: [*]const u8, method_len: usize, args: [*]Variant, args_len: usize, result: *Variant) void;
+// Interned names are passed as a null name, with the handle in place of the length
+pub extern fn sys_vcall_interned(self: *Variant, method: usize, name_id: usize, args: [*]Variant, args_len: usize, result: *Variant) void;
+pub extern fn sys_intern_name(name: [*]const u8, name_len: usize) u32;
+
+// A method or property name interned by the host, which avoids
+// interning the name again on every call.
+pub const InternedName = struct {
+    id: u32,
+
+    pub fn init(name: []const u8) InternedName {
+        return InternedName{ .id = sys_intern_name(name.ptr, name.len) };
+    }
+};
 
 pub const Variant = struct {
     type: i64,
@@ -37,16 +50,31 @@ pub const Variant = struct {
         sys_vcall(self, method.ptr, method.len, args.ptr, args.len, &result);
         return result;
     }
+
+    pub fn call_interned(self: *Variant, method: InternedName, args: []Variant) Variant {
+        var result: Variant = undefined;
+        sys_vcall_interned(self, 0, method.id, args.ptr, args.len, &result);
+        return result;
+    }
 };
 
 comptime {
     asm (
         \\.global sys_vcall;
         \\.type sys_vcall, @function;
+        \\.global sys_vcall_interned;
+        \\.type sys_vcall_interned, @function;
         \\sys_vcall:
+        \\sys_vcall_interned:
         \\  li a7, 501
         \\  ecall
         \\  ret
+        \\.global sys_intern_name;
+        \\.type sys_intern_name, @function;
+        \\sys_intern_name:
+        \\  li a7, 552
+        \\  ecall
+        \\  ret
         \\.global fast_exit;
         \\.type fast_exit, @function;
         \\fast_exit:
@@ -0,0 +1,185 @@
+#include "compile_scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <godot_cpp/core/error_macros.hpp>
+#include <godot_cpp/variant/string.hpp>
+#include <thread>
+
+using namespace godot;
+
+CompileScheduler &CompileScheduler::get() {
+	// Never destroyed, as detached workers may still be compiling at exit
+	static CompileScheduler *scheduler = new CompileScheduler();
+	return *scheduler;
+}
+
+CompileScheduler::CompileScheduler() :
+		// Leave room for the main thread, and the rest of the engine
+		CompileScheduler(std::max(1u, std::thread::hardware_concurrency() / 2)) {
+}
+
+CompileScheduler::CompileScheduler(unsigned max_workers) :
+		m_max_workers(std::max(1u, max_workers)) {
+}
+
+bool CompileScheduler::submit(uint64_t key, int priority, const void *owner, bool cancellable, std::function<void()> &&job) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	if (key != 0) {
+		// Merge with work that has not started yet. Work that is already running may
+		// be based on an older state, so a new job is queued to run after it.
+		for (Job &queued : m_queue) {
+			if (queued.key == key) {
+				queued.priority = std::max(queued.priority, priority);
+				queued.cancellable = queued.cancellable && cancellable;
+				if (owner != nullptr)
+					queued.owners.push_back(owner);
+				return false;
+			}
+		}
+	}
+	Job &queued = m_queue.emplace_back(Job{ key, priority, m_sequence++, {}, cancellable, std::move(job) });
+	if (owner != nullptr)
+		queued.owners.push_back(owner);
+
+	this->enqueue(lock);
+	return true;
+}
+
+void CompileScheduler::enqueue(std::unique_lock<std::mutex> &lock) {
+	if (m_idle_workers == 0 && m_workers < m_max_workers) {
+		m_workers++;
+		std::thread(&CompileScheduler::worker, this).detach();
+	} else {
+		lock.unlock();
+		m_cv.notify_one();
+	}
+}
+
+void CompileScheduler::defer(uint64_t key, const void *owner, bool cancellable, std::function<void()> &&job) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (Job &deferred : m_deferred) {
+		if (deferred.key == key) {
+			deferred.cancellable = deferred.cancellable && cancellable;
+			if (owner != nullptr)
+				deferred.owners.push_back(owner);
+			return;
+		}
+	}
+	Job &deferred = m_deferred.emplace_back(Job{ key, 0, 0, {}, cancellable, std::move(job) });
+	if (owner != nullptr)
+		deferred.owners.push_back(owner);
+}
+
+bool CompileScheduler::promote(uint64_t key, int priority) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	auto it = std::find_if(m_deferred.begin(), m_deferred.end(), [key](const Job &job) { return job.key == key; });
+	if (it == m_deferred.end())
+		return false;
+	Job job = std::move(*it);
+	m_deferred.erase(it);
+	job.priority = priority;
+	job.sequence = m_sequence++;
+	m_queue.push_back(std::move(job));
+
+	this->enqueue(lock);
+	return true;
+}
+
+bool CompileScheduler::add_owner(uint64_t key, const void *owner) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (std::vector<Job> *jobs : { &m_queue, &m_deferred }) {
+		for (Job &job : *jobs) {
+			if (job.key != key)
+				continue;
+			if (std::find(job.owners.begin(), job.owners.end(), owner) == job.owners.end())
+				job.owners.push_back(owner);
+			return true;
+		}
+	}
+	return false;
+}
+
+void CompileScheduler::cancel(const void *owner) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (std::vector<Job> *jobs : { &m_queue, &m_deferred }) {
+		for (auto it = jobs->begin(); it != jobs->end();) {
+			std::vector<const void *> &owners = it->owners;
+			owners.erase(std::remove(owners.begin(), owners.end(), owner), owners.end());
+			if (it->cancellable && owners.empty()) {
+				it = jobs->erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+}
+
+void CompileScheduler::set_priority(const void *owner, int priority) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (Job &job : m_queue) {
+		if (std::find(job.owners.begin(), job.owners.end(), owner) != job.owners.end())
+			job.priority = priority;
+	}
+}
+
+size_t CompileScheduler::get_queued_jobs() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_queue.size();
+}
+
+size_t CompileScheduler::get_deferred_jobs() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_deferred.size();
+}
+
+void CompileScheduler::worker() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		// Idle workers stay around for a while, in case more programs are loaded
+		m_idle_workers++;
+		auto next = m_queue.end();
+		const bool has_job = m_cv.wait_for(lock, std::chrono::seconds(10), [this, &next] {
+			next = this->next_job();
+			return next != m_queue.end();
+		});
+		m_idle_workers--;
+		if (!has_job) {
+			m_workers--;
+			return;
+		}
+		Job job = std::move(*next);
+		m_queue.erase(next);
+		if (job.key != 0)
+			m_running.push_back(job.key);
+
+		lock.unlock();
+		try {
+			if (job.work)
+				job.work();
+		} catch (const std::exception &e) {
+			String what = e.what();
+			ERR_PRINT("Background compilation exception: " + what);
+		}
+		lock.lock();
+
+		if (job.key != 0) {
+			m_running.erase(std::find(m_running.begin(), m_running.end(), job.key));
+			// A job with the same key may have been waiting for this one to finish
+			m_cv.notify_all();
+		}
+	}
+}
+
+std::vector<CompileScheduler::Job>::iterator CompileScheduler::next_job() {
+	// The highest priority, and then the oldest, skipping work that is already running
+	auto next = m_queue.end();
+	for (auto it = m_queue.begin(); it != m_queue.end(); ++it) {
+		if (it->key != 0 && std::find(m_running.begin(), m_running.end(), it->key) != m_running.end())
+			continue;
+		if (next == m_queue.end() || (it->priority != next->priority ? it->priority > next->priority : it->sequence < next->sequence))
+			next = it;
+	}
+	return next;
+}
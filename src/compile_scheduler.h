@@ -0,0 +1,97 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Runs background compilation jobs, such as binary translations, on a bounded
+ * number of worker threads shared by all sandboxes.
+ *
+ * Jobs with a higher priority run first, and jobs of equal priority run in the order
+ * they were submitted. Jobs with the same non-zero key are merged while they wait, and
+ * never run at the same time, so that the same program is only compiled once at a time.
+ * A job submitted while one with the same key is running runs after it. Jobs that have
+ * not started yet are dropped when all of their owners cancel them.
+ *
+ * Deferred jobs are held back until they are promoted, eg. once a program has proven
+ * to be hot enough to be worth compiling.
+ */
+class CompileScheduler {
+public:
+	static CompileScheduler &get();
+
+	/// @brief Queue a job.
+	/// @param key Identifies the work done by the job, or 0 if it should never be merged.
+	/// @param priority Jobs with a higher priority run first.
+	/// @param owner The sandbox the job belongs to, or nullptr.
+	/// @param cancellable If false, the job runs even when all of its owners cancel it.
+	/// @param job The work to run on a worker thread.
+	/// @return True if the job was queued, false if it was merged with a waiting job with the same key.
+	bool submit(uint64_t key, int priority, const void *owner, bool cancellable, std::function<void()> &&job);
+
+	/// @brief Hold back a job until it is promoted with the same key.
+	/// @param key Identifies the work done by the job, and must not be 0.
+	/// @param owner The sandbox the job belongs to, or nullptr.
+	/// @param cancellable If false, the job is kept even when all of its owners cancel it.
+	/// @param job The work to run on a worker thread once promoted.
+	void defer(uint64_t key, const void *owner, bool cancellable, std::function<void()> &&job);
+
+	/// @brief Queue a deferred job.
+	/// @param key The key the job was deferred with.
+	/// @param priority Jobs with a higher priority run first.
+	/// @return True if a deferred job was queued, false if there was none with the key.
+	bool promote(uint64_t key, int priority);
+
+	/// @brief Add an owner to the waiting or deferred job with a key, eg. another sandbox sharing
+	/// the program that the job compiles, so that the job is kept until all of its owners cancel it.
+	/// @return True if there was such a job.
+	bool add_owner(uint64_t key, const void *owner);
+
+	/// @brief Cancel the jobs of an owner that have not started yet, including deferred jobs.
+	/// Merged jobs still run if they have other owners, or if any of them was not cancellable.
+	void cancel(const void *owner);
+
+	/// @brief Change the priority of the jobs of an owner that have not started yet.
+	void set_priority(const void *owner, int priority);
+
+	/// @brief Get the number of jobs waiting to run.
+	size_t get_queued_jobs() const;
+	/// @brief Get the number of jobs waiting to be promoted.
+	size_t get_deferred_jobs() const;
+	/// @brief Get the number of worker threads.
+	unsigned get_worker_count() const noexcept { return m_max_workers; }
+
+private:
+	// The self-tests run on separate instances, see src/tests/compile_scheduler_tests.cpp
+	friend class CompileSchedulerTests;
+
+	CompileScheduler();
+	CompileScheduler(unsigned max_workers);
+	void worker();
+	void enqueue(std::unique_lock<std::mutex> &lock);
+
+	struct Job {
+		uint64_t key;
+		int priority;
+		uint64_t sequence;
+		std::vector<const void *> owners;
+		bool cancellable;
+		std::function<void()> work;
+	};
+	// Jobs waiting to run, in no particular order, as they are few and priorities change
+	std::vector<Job> m_queue;
+	// Jobs waiting to be promoted, which are not run by workers
+	std::vector<Job> m_deferred;
+	// Keys of the jobs that are running
+	std::vector<uint64_t> m_running;
+	// The job a worker should run next, or the end of the queue if there is none that can run
+	std::vector<Job>::iterator next_job();
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cv;
+	uint64_t m_sequence = 0;
+	unsigned m_workers = 0;
+	unsigned m_idle_workers = 0;
+	const unsigned m_max_workers;
+};
@@ -29,6 +29,8 @@ Variant ResourceFormatLoaderELF::_load(const String &p_path, const String &origi
 	Ref<ELFScript> elf_model = memnew(ELFScript);
 	elf_model->set_file(p_path);
 	elf_model->reload(false);
+	// A snapshot saved next to the ELF lets Sandboxes skip running main()
+	elf_model->load_snapshot(Sandbox::snapshot_path_for(p_path));
 	return elf_model;
 }
 PackedStringArray ResourceFormatLoaderELF::_get_recognized_extensions() const {
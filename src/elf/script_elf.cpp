@@ -1,4 +1,5 @@
 #include "script_elf.h"
+#include "../compile_scheduler.h"
 
 #include "../cpp/script_cpp.h"
 #include "../docker.h"
@@ -15,6 +16,7 @@ void ELFScript::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_sandbox_for", "for_object"), &ELFScript::get_sandbox_for);
 	ClassDB::bind_method(D_METHOD("get_sandbox_objects"), &ELFScript::get_sandbox_objects);
 	ClassDB::bind_method(D_METHOD("get_content"), &ELFScript::get_content);
+	ClassDB::bind_method(D_METHOD("load_snapshot", "path"), &ELFScript::load_snapshot);
 }
 
 Sandbox *ELFScript::get_sandbox_for(Object *p_for_object) const {
@@ -36,6 +38,35 @@ Array ELFScript::get_sandbox_objects() const {
 	return result;
 }
 
+Sandbox *ELFScript::get_template_sandbox() {
+	if (this->template_sandbox == nullptr) {
+		// The template is loaded from the program bytes instead of from this resource,
+		// as holding a reference to ourselves would create a reference cycle.
+		this->template_sandbox = memnew(Sandbox);
+		this->template_sandbox->load_buffer(this->get_content());
+	}
+	if (!this->template_sandbox->has_program_loaded()) {
+		return nullptr;
+	}
+	return this->template_sandbox;
+}
+
+bool ELFScript::load_snapshot(const String &p_path) {
+	if (!Sandbox::load_snapshot(p_path, this->source_code, this->snapshot)) {
+		this->snapshot = ELFSnapshot();
+		return false;
+	}
+	return true;
+}
+
+ELFScript::~ELFScript() {
+	if (this->template_sandbox != nullptr) {
+		memdelete(this->template_sandbox);
+	}
+	// Compilations of the pinned execute segment that have not started yet
+	CompileScheduler::get().cancel(this);
+}
+
 ELFScriptInstance *ELFScript::get_script_instance(Object *p_for_object) const {
 	for (ELFScriptInstance *instance : this->instances) {
 		if (instance->get_owner() == p_for_object) {
@@ -300,6 +331,10 @@ void ELFScript::set_file(const String &p_path) {
 		return;
 	}
 	source_code = std::move(new_source_code);
+	// A snapshot and the decoded code of the previous program are no longer valid
+	this->snapshot = ELFSnapshot();
+	this->execute_segment = nullptr;
+	CompileScheduler::get().cancel(this);
 
 	global_name = "Sandbox_" + path.get_basename().replace("res://", "").replace("/", "_").replace("-", "_").capitalize().replace(" ", "");
 	Sandbox::BinaryInfo info = Sandbox::get_program_info_from_binary(source_code);
@@ -312,7 +347,20 @@ void ELFScript::set_file(const String &p_path) {
 	if constexpr (VERBOSE_ELFSCRIPT) {
 		printf("ELFScript::set_file: %s Sandbox instances: %u\n", std_path.c_str(), sandbox_map[path].size());
 	}
-	for (Sandbox *sandbox : sandbox_map[path]) {
+	// Unloads any Sandboxes that were forked from the old program
+	if (this->template_sandbox != nullptr) {
+		memdelete(this->template_sandbox);
+		this->template_sandbox = nullptr;
+	}
+	// Reloading a Sandbox registers it again, so iterate over a copy
+	std::vector<Sandbox *> sandboxes;
+	{
+		std::lock_guard<std::mutex> lock(sandbox_map_mutex);
+		for (Sandbox *sandbox : sandbox_map[path]) {
+			sandboxes.push_back(sandbox);
+		}
+	}
+	for (Sandbox *sandbox : sandboxes) {
 		sandbox->set_program(Ref<ELFScript>(this));
 	}
 
@@ -3,9 +3,27 @@
 #include <godot_cpp/classes/script_extension.hpp>
 #include <godot_cpp/classes/script_language.hpp>
 #include <godot_cpp/templates/hash_set.hpp>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 using namespace godot;
 class ELFScriptInstance;
+
+/// @brief A machine image of a program taken after main() returned, restored instead of running main() again.
+struct ELFSnapshot {
+	uint32_t memory_max = 0;
+	Array functions;
+	Array properties;
+	Array variants;
+	PackedInt32Array variant_generations;
+	PackedInt32Array free_variant_slots;
+	PackedStringArray interned_names;
+	std::vector<uint8_t> image;
+
+	bool is_valid() const noexcept { return !image.empty(); }
+};
+
 class Sandbox;
 namespace godot {
 	class ScriptInstanceExtension;
@@ -29,6 +47,14 @@ protected:
 	friend class SafeGDScript;
 
 	static inline HashMap<String, HashSet<Sandbox *>> sandbox_map;
+	// Sandboxes may be created and destroyed on worker threads
+	static inline std::mutex sandbox_map_mutex;
+	// Fully initialized instance that new Sandboxes can be forked from
+	Sandbox *template_sandbox = nullptr;
+	ELFSnapshot snapshot;
+	// Keeps the decoded execute segment (and its binary translation) alive between instances.
+	// Type-erased, as the segment type belongs to libriscv.
+	std::shared_ptr<void> execute_segment;
 
 public:
 	Array functions;
@@ -61,8 +87,35 @@ public:
 	/// @return A reference to the ELFScript instance.
 	ELFScriptInstance *get_script_instance(Object *p_for_object) const;
 
-	void register_instance(Sandbox *p_sandbox) { sandbox_map[path].insert(p_sandbox); }
-	void unregister_instance(Sandbox *p_sandbox) { sandbox_map[path].erase(p_sandbox); }
+	/// @brief Retrieve the post-initialization snapshot of this program, if one was loaded.
+	/// @return The snapshot, which is invalid if there is none.
+	const ELFSnapshot &get_snapshot() const noexcept { return snapshot; }
+	/// @brief Load a post-initialization snapshot, if it matches the current program.
+	/// Snapshots are only created explicitly, by Sandbox.save_snapshot(). A snapshot that
+	/// was loaded before is dropped when the new one does not exist or does not match.
+	/// @param p_path The path to the snapshot file.
+	/// @return True if the snapshot was loaded, false otherwise.
+	bool load_snapshot(const String &p_path);
+
+	/// @brief Keep the decoded main execute segment of this program alive, so that it is
+	/// shared by all instances instead of being decoded again when the last instance is gone.
+	/// @param p_segment The decoded execute segment.
+	void set_execute_segment(std::shared_ptr<void> p_segment) { execute_segment = std::move(p_segment); }
+	bool has_execute_segment() const noexcept { return execute_segment != nullptr; }
+
+	/// @brief Retrieve a fully initialized Sandbox instance for this program, creating it on first use.
+	/// New Sandbox instances can be forked from it instead of loading the program and running main().
+	/// @return The template Sandbox instance, or nullptr if the program could not be loaded.
+	Sandbox *get_template_sandbox();
+
+	void register_instance(Sandbox *p_sandbox) {
+		std::lock_guard<std::mutex> lock(sandbox_map_mutex);
+		sandbox_map[path].insert(p_sandbox);
+	}
+	void unregister_instance(Sandbox *p_sandbox) {
+		std::lock_guard<std::mutex> lock(sandbox_map_mutex);
+		sandbox_map[path].erase(p_sandbox);
+	}
 
 	virtual bool _editor_can_reload_from_file() override;
 	virtual void _placeholder_erased(void *p_placeholder) override;
@@ -103,5 +156,5 @@ public:
 	void set_file(const String &path);
 
 	ELFScript() {}
-	~ELFScript() {}
+	~ELFScript();
 };
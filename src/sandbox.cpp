@@ -1,14 +1,13 @@
 #include "sandbox.h"
 
+#include "compile_scheduler.h"
 #include "guest_datatypes.h"
+#include "sandbox_call_site.h"
 #include "sandbox_project_settings.h"
 #include <godot_cpp/classes/engine.hpp>
 #include <godot_cpp/classes/time.hpp>
 #include <godot_cpp/core/class_db.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
-#if defined(RISCV_BINARY_TRANSLATION) && defined(RISCV_LIBTCC)
-#include <future>
-#endif
 
 using namespace godot;
 
@@ -19,11 +18,13 @@ static const std::vector<std::string> program_arguments = { "program" };
 static riscv::Machine<RISCV_ARCH> dummy_machine;
 enum SandboxPropertyNameIndex : int {
 	PROP_REFERENCES_MAX,
+	PROP_CALL_DEPTH_MAX,
 	PROP_MEMORY_MAX,
 	PROP_EXECUTION_TIMEOUT,
 	PROP_ALLOCATIONS_MAX,
 	PROP_UNBOXED_ARGUMENTS,
 	PROP_PRECISE_SIMULATION,
+	PROP_DEFERRED_WRITES,
 #ifdef RISCV_LIBTCC
 	PROP_BINTR_NBIT_AS,
 	PROP_BINTR_REG_CACHE,
@@ -47,17 +48,24 @@ enum SandboxPropertyNameIndex : int {
 };
 static std::vector<StringName> property_names;
 
+static void sandbox_printer(const machine_t &m, const char *str, size_t len) {
+	Sandbox *sandbox = m.get_userdata<Sandbox>();
+	sandbox->print(String::utf8(str, len));
+}
+
 void Sandbox::Initialize()
 {
 	Sandbox::initialize_syscalls();
 
 	property_names = {
 		"references_max",
+		"call_depth_max",
 		"memory_max",
 		"execution_timeout",
 		"allocations_max",
 		"unboxed_arguments",
 		"precise_simulation",
+		"deferred_writes",
 #ifdef RISCV_LIBTCC
 		"binary_translation_nbit_as",
 		"binary_translation_register_caching",
@@ -89,9 +97,13 @@ void Sandbox::_bind_methods() {
 	// Constructors.
 	ClassDB::bind_static_method("Sandbox", D_METHOD("FromBuffer", "buffer"), &Sandbox::FromBuffer);
 	ClassDB::bind_static_method("Sandbox", D_METHOD("FromProgram", "program"), &Sandbox::FromProgram);
+	ClassDB::bind_static_method("Sandbox", D_METHOD("FromTemplate", "program"), &Sandbox::FromTemplate);
+	ClassDB::bind_static_method("Sandbox", D_METHOD("vmcall_parallel", "sandboxes", "function", "args"), &Sandbox::vmcall_parallel, DEFVAL(Array()));
 	// Methods.
 	ClassDB::bind_method(D_METHOD("load_buffer", "buffer"), &Sandbox::load_buffer);
 	ClassDB::bind_method(D_METHOD("reset", "unload"), &Sandbox::reset, DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("fork_from", "initialized"), &Sandbox::fork_from);
+	ClassDB::bind_method(D_METHOD("save_snapshot", "path"), &Sandbox::save_snapshot);
 	{
 		MethodInfo mi;
 		//mi.arguments.push_back(PropertyInfo(Variant::STRING, "function"));
@@ -101,7 +113,10 @@ void Sandbox::_bind_methods() {
 		ClassDB::bind_vararg_method(METHOD_FLAGS_DEFAULT, "vmcallv", &Sandbox::vmcallv, mi, DEFVAL(std::vector<Variant>{}));
 	}
 	ClassDB::bind_method(D_METHOD("vmcallable", "function", "args"), &Sandbox::vmcallable, DEFVAL(Array{}));
+	ClassDB::bind_method(D_METHOD("vmcall_batch", "function", "argument_arrays"), &Sandbox::vmcall_batch);
+	ClassDB::bind_method(D_METHOD("vmcall_batch_packed", "function", "arguments", "arguments_per_call", "call_count"), &Sandbox::vmcall_batch_packed, DEFVAL(1), DEFVAL(-1));
 	ClassDB::bind_method(D_METHOD("vmcallable_address", "address", "args"), &Sandbox::vmcallable_address, DEFVAL(Array{}));
+	ClassDB::bind_method(D_METHOD("create_call_site", "function", "argument_types", "return_type"), &Sandbox::create_call_site, DEFVAL(PackedInt32Array()), DEFVAL(int(Variant::NIL)));
 
 	// Sandbox restrictions.
 	ClassDB::bind_method(D_METHOD("set_restrictions", "restrictions"), &Sandbox::set_restrictions);
@@ -131,6 +146,7 @@ void Sandbox::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("resume", "max_instructions"), &Sandbox::resume);
 
 	ClassDB::bind_method(D_METHOD("assault", "test", "iterations"), &Sandbox::assault);
+	ClassDB::bind_static_method("Sandbox", D_METHOD("test_compile_scheduler"), &Sandbox::test_compile_scheduler);
 	ClassDB::bind_method(D_METHOD("has_function", "function"), &Sandbox::has_function);
 	ClassDB::bind_method(D_METHOD("address_of", "symbol"), &Sandbox::address_of);
 	ClassDB::bind_method(D_METHOD("lookup_address", "address"), &Sandbox::lookup_address);
@@ -147,19 +163,26 @@ void Sandbox::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("share_vec3_array", "allow_write", "array"), &Sandbox::share_vec3_array);
 	ClassDB::bind_method(D_METHOD("share_vec4_array", "allow_write", "array"), &Sandbox::share_vec4_array);
 	ClassDB::bind_method(D_METHOD("unshare_array", "address"), &Sandbox::unshare_array);
+	ClassDB::bind_static_method("Sandbox", D_METHOD("page_padded_size", "element_count", "element_size"), &Sandbox::page_padded_size, DEFVAL(1));
+	ClassDB::bind_method(D_METHOD("open_channel", "capacity"), &Sandbox::open_channel);
+	ClassDB::bind_method(D_METHOD("close_channel", "address"), &Sandbox::close_channel);
+	ClassDB::bind_method(D_METHOD("channel_send", "address", "message"), &Sandbox::channel_send);
+	ClassDB::bind_method(D_METHOD("channel_receive", "address"), &Sandbox::channel_receive);
 
 	// Profiling.
 	ClassDB::bind_static_method("Sandbox", D_METHOD("get_hotspots", "total", "callable"), &Sandbox::get_hotspots, DEFVAL(6), DEFVAL(Callable()));
 	ClassDB::bind_static_method("Sandbox", D_METHOD("clear_hotspots"), &Sandbox::clear_hotspots);
 
 	// Binary translation.
-	ClassDB::bind_method(D_METHOD("emit_binary_translation", "ignore_instruction_limit", "automatic_nbit_address_space"), &Sandbox::emit_binary_translation, DEFVAL(false), DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("emit_binary_translation", "ignore_instruction_limit", "automatic_nbit_address_space", "options"), &Sandbox::emit_binary_translation, DEFVAL(false), DEFVAL(false), DEFVAL(Dictionary()));
 	ClassDB::bind_static_method("Sandbox", D_METHOD("load_binary_translation", "shared_library_path", "allow_insecure"), &Sandbox::load_binary_translation, DEFVAL("res://bintr.so"), DEFVAL(false));
-	ClassDB::bind_method(D_METHOD("try_compile_binary_translation", "shared_library_path", "compiler", "extra_cflags", "ignore_instruction_limit", "automatic_nbit_as"), &Sandbox::try_compile_binary_translation, DEFVAL("res://bintr"), DEFVAL("cc"), DEFVAL(""), DEFVAL(false), DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("try_compile_binary_translation", "shared_library_path", "compiler", "extra_cflags", "ignore_instruction_limit", "automatic_nbit_as", "options"), &Sandbox::try_compile_binary_translation, DEFVAL("res://bintr"), DEFVAL("cc"), DEFVAL(""), DEFVAL(false), DEFVAL(false), DEFVAL(Dictionary()));
+	ClassDB::bind_static_method("Sandbox", D_METHOD("try_compile_binary_translation_bundle", "shared_library_path", "compiler", "extra_cflags", "ignore_instruction_limit", "automatic_nbit_as", "options", "programs"), &Sandbox::try_compile_binary_translation_bundle, DEFVAL("res://bintr"), DEFVAL("cc"), DEFVAL(""), DEFVAL(false), DEFVAL(false), DEFVAL(Dictionary()), DEFVAL(PackedStringArray()));
 	ClassDB::bind_method(D_METHOD("is_binary_translated"), &Sandbox::is_binary_translated);
 	ClassDB::bind_method(D_METHOD("is_jit"), &Sandbox::is_jit);
 	ClassDB::bind_static_method("Sandbox", D_METHOD("set_jit_enabled", "enable"), &Sandbox::set_jit_enabled);
 	ClassDB::bind_static_method("Sandbox", D_METHOD("is_jit_enabled"), &Sandbox::is_jit_enabled);
+	ClassDB::bind_static_method("Sandbox", D_METHOD("get_background_compilations"), &Sandbox::get_background_compilations);
 	ClassDB::bind_static_method("Sandbox", D_METHOD("has_feature_jit"), &Sandbox::has_feature_jit);
 
 	// Properties.
@@ -170,6 +193,10 @@ void Sandbox::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_max_refs", "max"), &Sandbox::set_max_refs, DEFVAL(MAX_REFS));
 	ClassDB::bind_method(D_METHOD("get_max_refs"), &Sandbox::get_max_refs);
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "references_max", PROPERTY_HINT_NONE, "Maximum objects and variants referenced by a sandbox call"), "set_max_refs", "get_max_refs");
+	ClassDB::bind_method(D_METHOD("set_max_call_depth", "max"), &Sandbox::set_max_call_depth, DEFVAL(MAX_LEVEL));
+	ClassDB::bind_method(D_METHOD("get_max_call_depth"), &Sandbox::get_max_call_depth);
+	ClassDB::bind_method(D_METHOD("get_call_depth"), &Sandbox::get_call_depth);
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "call_depth_max", PROPERTY_HINT_RANGE, "1,64"), "set_max_call_depth", "get_max_call_depth");
 
 	ClassDB::bind_method(D_METHOD("set_memory_max", "max"), &Sandbox::set_memory_max, DEFVAL(MAX_VMEM));
 	ClassDB::bind_method(D_METHOD("get_memory_max"), &Sandbox::get_memory_max);
@@ -190,6 +217,12 @@ void Sandbox::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_precise_simulation", "precise_simulation"), &Sandbox::set_precise_simulation);
 	ClassDB::bind_method(D_METHOD("get_precise_simulation"), &Sandbox::get_precise_simulation);
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "precise_simulation", PROPERTY_HINT_NONE, "Use precise simulation for VM execution"), "set_precise_simulation", "get_precise_simulation");
+	ClassDB::bind_method(D_METHOD("set_deferred_writes", "deferred_writes"), &Sandbox::set_deferred_writes);
+	ClassDB::bind_method(D_METHOD("get_deferred_writes"), &Sandbox::get_deferred_writes);
+	ClassDB::bind_method(D_METHOD("get_deferred_write_count"), &Sandbox::get_deferred_write_count);
+	ClassDB::bind_method(D_METHOD("flush_deferred_writes"), &Sandbox::flush_deferred_writes);
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "deferred_writes", PROPERTY_HINT_NONE, "Record scene tree writes and apply them in flush_deferred_writes()"), "set_deferred_writes", "get_deferred_writes");
+	ClassDB::bind_method(D_METHOD("get_interned_name_count"), &Sandbox::get_interned_name_count);
 
 	ClassDB::bind_method(D_METHOD("set_binary_translation_nbit_as", "use_nbit_as"), &Sandbox::set_binary_translation_automatic_nbit_as);
 	ClassDB::bind_method(D_METHOD("get_binary_translation_nbit_as"), &Sandbox::get_binary_translation_automatic_nbit_as);
@@ -205,6 +238,11 @@ void Sandbox::_bind_methods() {
 
 	ClassDB::bind_method(D_METHOD("set_binary_translation_bg_compilation", "bg_compilation"), &Sandbox::set_binary_translation_bg_compilation);
 	ClassDB::bind_method(D_METHOD("get_binary_translation_bg_compilation"), &Sandbox::get_binary_translation_bg_compilation);
+	ClassDB::bind_method(D_METHOD("set_binary_translation_priority", "priority"), &Sandbox::set_binary_translation_priority);
+	ClassDB::bind_method(D_METHOD("get_binary_translation_priority"), &Sandbox::get_binary_translation_priority);
+	ClassDB::bind_method(D_METHOD("set_binary_translation_tier_threshold", "threshold"), &Sandbox::set_binary_translation_tier_threshold);
+	ClassDB::bind_method(D_METHOD("get_binary_translation_tier_threshold"), &Sandbox::get_binary_translation_tier_threshold);
+	ClassDB::bind_method(D_METHOD("get_jit_cache_path", "binary"), &Sandbox::get_jit_cache_path);
 
 	ClassDB::bind_method(D_METHOD("set_profiling", "enable"), &Sandbox::set_profiling, DEFVAL(false));
 	ClassDB::bind_method(D_METHOD("get_profiling"), &Sandbox::get_profiling);
@@ -266,11 +304,13 @@ std::vector<PropertyInfo> Sandbox::create_sandbox_property_list() {
 
 	// Group for sandbox restrictions.
 	list.push_back(PropertyInfo(Variant::INT, "references_max", PROPERTY_HINT_NONE));
+	list.push_back(PropertyInfo(Variant::INT, "call_depth_max", PROPERTY_HINT_NONE));
 	list.push_back(PropertyInfo(Variant::INT, "memory_max", PROPERTY_HINT_NONE));
 	list.push_back(PropertyInfo(Variant::INT, "execution_timeout", PROPERTY_HINT_NONE));
 	list.push_back(PropertyInfo(Variant::INT, "allocations_max", PROPERTY_HINT_NONE));
 	list.push_back(PropertyInfo(Variant::BOOL, "unboxed_arguments", PROPERTY_HINT_NONE));
 	list.push_back(PropertyInfo(Variant::BOOL, "precise_simulation", PROPERTY_HINT_NONE));
+	list.push_back(PropertyInfo(Variant::BOOL, "deferred_writes", PROPERTY_HINT_NONE));
 #ifdef RISCV_LIBTCC
 	list.push_back(PropertyInfo(Variant::BOOL, "binary_translation_nbit_as", PROPERTY_HINT_NONE));
 	list.push_back(PropertyInfo(Variant::BOOL, "binary_translation_register_caching", PROPERTY_HINT_NONE));
@@ -297,6 +337,11 @@ std::vector<PropertyInfo> Sandbox::create_sandbox_property_list() {
 }
 
 void Sandbox::constructor_initialize() {
+	if (this->m_states.empty()) {
+		// The permanent state, and the first call level
+		this->m_states.resize(2);
+	}
+	this->m_level = 0;
 	this->m_current_state = &this->m_states[0];
 	this->m_use_unboxed_arguments = SandboxProjectSettings::use_native_types();
 	// For each call state, reset the state
@@ -304,7 +349,33 @@ void Sandbox::constructor_initialize() {
 		this->m_states[i].reinitialize(i, this->m_max_refs);
 	}
 }
+void Sandbox::detach_forks() {
+	// Stop sharing pages with the sandbox we were forked from
+	if (this->m_fork_parent != nullptr) {
+		std::vector<Sandbox *> &siblings = this->m_fork_parent->m_forks;
+		siblings.erase(std::remove(siblings.begin(), siblings.end(), this), siblings.end());
+		this->m_fork_parent = nullptr;
+	}
+	// Forks are borrowing our pages, so they must be unloaded first
+	std::vector<Sandbox *> forks = std::move(this->m_forks);
+	this->m_forks.clear();
+	for (Sandbox *fork : forks) {
+		if (fork->is_in_vmcall()) {
+			ERR_PRINT("Sandbox fork unloaded while a VM call is in progress.");
+		}
+		fork->m_fork_parent = nullptr;
+		fork->full_reset();
+	}
+}
 void Sandbox::reset_machine() {
+	this->detach_forks();
+	this->m_program_generation++;
+#if defined(RISCV_BINARY_TRANSLATION) && defined(RISCV_LIBTCC)
+	// Compilations that have not started yet are no longer needed, unless other machines share them
+	CompileScheduler::get().cancel(this);
+	this->m_bintr_key = 0;
+	this->m_bintr_tier_key = 0;
+#endif
 	try {
 		if (this->m_machine != &dummy_machine) {
 			delete this->m_machine;
@@ -322,7 +393,16 @@ void Sandbox::full_reset() {
 
 	this->m_properties.clear();
 	this->m_lookup.clear();
+	this->m_unboxed_returns.clear();
 	this->m_allowed_objects.clear();
+	this->m_deferred_commands.clear();
+	this->m_interned_names.clear();
+	this->m_interned_name_lookup.clear();
+	this->m_array_views.clear();
+	this->m_channels.clear();
+	// The pages of shared memory went away with the machine
+	this->m_shared_memory_ranges.clear();
+	this->m_shared_memory_allocator.clear();
 }
 Sandbox::Sandbox() {
 	this->constructor_initialize();
@@ -346,12 +426,7 @@ Sandbox::~Sandbox() {
 	}
 	this->m_global_instances_current -= 1;
 	this->set_program_data_internal(nullptr);
-	try {
-		if (this->m_machine != &dummy_machine)
-			delete this->m_machine;
-	} catch (const std::exception &e) {
-		ERR_PRINT(("Sandbox exception: " + std::string(e.what())).c_str());
-	}
+	this->reset_machine();
 }
 
 void Sandbox::set_memory_max(uint32_t max) {
@@ -479,6 +554,133 @@ void Sandbox::reset(bool unload) {
 		}
 	}
 }
+Sandbox *Sandbox::FromTemplate(Ref<ELFScript> program) {
+	Sandbox *sandbox = memnew(Sandbox);
+	if (program.is_valid() && !sandbox->fork_from_template(program)) {
+		// Fall back to a regular (slow) load of the program
+		sandbox->set_program(program);
+	}
+	return sandbox;
+}
+bool Sandbox::fork_from_template(Ref<ELFScript> program) {
+	Sandbox *initialized = program->get_template_sandbox();
+	if (initialized == nullptr || !this->fork_from(initialized)) {
+		return false;
+	}
+	// The template is loaded from the program bytes, so register
+	// with the program in order to be reloaded when it changes.
+	this->set_program_data_internal(program);
+	this->m_source_version = program->get_source_version();
+	this->cache_public_api_functions(program->functions);
+	return true;
+}
+bool Sandbox::fork_from(Sandbox *initialized) {
+	if (this->is_in_vmcall()) {
+		ERR_PRINT("Cannot fork a sandbox while a VM call is in progress.");
+		return false;
+	}
+	if (initialized == nullptr || initialized == this || !initialized->has_program_loaded()) {
+		ERR_PRINT("Sandbox::fork_from: The sandbox to fork from has no program loaded.");
+		return false;
+	}
+	if (initialized->is_in_vmcall() || initialized->is_initializing()) {
+		ERR_PRINT("Sandbox::fork_from: Cannot fork a sandbox that is running.");
+		return false;
+	}
+	if (!initialized->m_shared_memory_ranges.empty() || !initialized->m_channels.empty()) {
+		// Shared arrays and channels are non-owned host memory, which cannot be shared copy-on-write
+		ERR_PRINT("Sandbox::fork_from: Cannot fork a sandbox with shared memory ranges.");
+		return false;
+	}
+	if (!initialized->m_states[0].scoped_objects.empty()) {
+		// Objects are only allowed in the context of the sandbox they were passed to
+		ERR_PRINT("Sandbox::fork_from: Cannot fork a sandbox that holds permanent object references.");
+		return false;
+	}
+
+	// Get t0 for the startup time
+	const uint64_t startup_t0 = Time::get_singleton()->get_ticks_usec();
+
+	// The fork runs the same program with the same limits as the initialized sandbox
+	this->set_program_data_internal(initialized->m_program_data);
+	this->m_program_bytes = initialized->m_program_bytes;
+	this->m_source_version = initialized->m_source_version;
+	this->m_max_refs = initialized->m_max_refs;
+	this->m_max_level = initialized->m_max_level;
+	this->m_memory_max = initialized->m_memory_max;
+	this->m_insn_max = initialized->m_insn_max;
+	this->m_allocations_max = initialized->m_allocations_max;
+	this->m_precise_simulation = initialized->m_precise_simulation;
+	this->m_deferred_writes = initialized->m_deferred_writes;
+#ifdef RISCV_LIBTCC
+	this->m_bintr_automatic_nbit_as = initialized->m_bintr_automatic_nbit_as;
+	this->m_bintr_register_caching = initialized->m_bintr_register_caching;
+	this->m_bintr_bg_compilation = initialized->m_bintr_bg_compilation;
+	this->m_bintr_tier_threshold = initialized->m_bintr_tier_threshold;
+#endif
+	this->full_reset();
+	this->m_use_unboxed_arguments = initialized->m_use_unboxed_arguments;
+#if defined(RISCV_BINARY_TRANSLATION) && defined(RISCV_LIBTCC)
+	// The fork shares the execute segment, and so the compilation, of the initialized sandbox
+	this->m_bintr_key = initialized->m_bintr_key;
+	this->m_bintr_tier_key = initialized->m_bintr_tier_key;
+	this->m_bintr_tier_calls = 0;
+	if (this->m_bintr_key != 0)
+		CompileScheduler::get().add_owner(this->m_bintr_key, this);
+#endif
+
+	try {
+		// Memory pages, the native heap arena and the CPU registers are inherited
+		// from the initialized machine, with pages being shared copy-on-write.
+		auto options = std::make_shared<riscv::MachineOptions<RISCV_ARCH>>(initialized->machine().options());
+		this->m_machine = new machine_t{ initialized->machine(), *options };
+		this->m_machine->set_options(std::move(options));
+	} catch (const std::exception &e) {
+		ERR_PRINT(("Sandbox fork exception: " + std::string(e.what())).c_str());
+		this->m_machine = &dummy_machine;
+		return false;
+	}
+	this->m_fork_parent = initialized;
+	initialized->m_forks.push_back(this);
+
+	machine_t &m = machine();
+	m.set_userdata(this);
+	m.set_printer(sandbox_printer);
+	if (m.has_arena()) {
+		m.arena().set_max_chunks(get_allocations_max());
+	}
+
+	// Permanent Variants are duplicated, so that forks don't share mutable containers
+	// Slots keep their generations, so that handles held by the guest remain valid
+	const CurrentState &perm_state = initialized->m_states[0];
+	for (const Variant *var : perm_state.scoped_variants) {
+		this->m_states[0].append_permanent(var ? var->duplicate(true) : Variant());
+	}
+	this->m_states[0].generations = perm_state.generations;
+	this->m_states[0].free_slots = perm_state.free_slots;
+
+	this->m_properties = initialized->m_properties;
+	this->m_lookup = initialized->m_lookup;
+	this->m_unboxed_returns = initialized->m_unboxed_returns;
+	// Interned names and method handles may already be held in guest memory
+	this->m_interned_names = initialized->m_interned_names;
+	this->m_interned_name_lookup = initialized->m_interned_name_lookup;
+
+	// Accumulate startup time
+	const uint64_t startup_t1 = Time::get_singleton()->get_ticks_usec();
+	m_accumulated_startup_time += (startup_t1 - startup_t0) / 1e6;
+	return true;
+}
+void Sandbox::cache_public_api_functions(const Array &functions) {
+	// Cache the public API functions from the ELFScript object
+	for (int i = 0; i < functions.size(); i++) {
+		const Dictionary func = functions[i];
+		String name = func["name"];
+		const gaddr_t address = func.get("address", 0x0);
+		const Variant::Type unboxed_return = Variant::Type(int(func.get("unboxed_return", Variant::VARIANT_MAX)));
+		this->add_cached_address(name, address, unboxed_return);
+	}
+}
 bool Sandbox::has_program_loaded() const {
 	return !machine().memory.binary().empty();
 }
@@ -493,11 +695,26 @@ bool Sandbox::load(const PackedByteArray *buffer, const std::vector<std::string>
 	// Get t0 for the startup time
 	const uint64_t startup_t0 = Time::get_singleton()->get_ticks_usec();
 
+#if defined(RISCV_BINARY_TRANSLATION) && defined(RISCV_LIBTCC)
+	// A translation of this program compiled by an earlier run is loaded instead of JIT-compiling it again
+	String jit_cache_path;
+	bool jit_cache_loaded = false;
+	if (m_bintr_jit && SandboxProjectSettings::use_jit_cache()) {
+		jit_cache_path = this->get_jit_cache_path(*buffer);
+		jit_cache_loaded = !jit_cache_path.is_empty() && this->load_jit_cache(jit_cache_path);
+	}
+#endif
+
 	/** We can't handle exceptions until the Machine is fully constructed. Two steps.  */
 	try {
 		// Reset the machine
 		if (this->m_machine != &dummy_machine)
 			delete this->m_machine;
+#if defined(RISCV_BINARY_TRANSLATION) && defined(RISCV_LIBTCC)
+		CompileScheduler::get().cancel(this);
+		this->m_bintr_key = 0;
+		this->m_bintr_tier_key = 0;
+#endif
 
 		auto options = std::make_shared<riscv::MachineOptions<RISCV_ARCH>>(riscv::MachineOptions<RISCV_ARCH>{
 				.memory_max = uint64_t(get_memory_max()) << 20, // in MiB
@@ -517,34 +734,57 @@ bool Sandbox::load(const PackedByteArray *buffer, const std::vector<std::string>
 #  endif // RISCV_LIBTCC
 #endif
 		});
+		// Instances of the same program share one immutable, refcounted decoded execute
+		// segment (and binary translation), looked up by hash when the machine is constructed.
+		options->use_shared_execute_segments = true;
 #if defined(RISCV_BINARY_TRANSLATION) && defined(RISCV_LIBTCC)
-		// Background compilation, if enabled, will run the compilation in a separate thread
+		// Background compilation, if enabled, will run the compilation on a worker thread
 		// and live-patch the results into the decoder cache after the compilation is done.
 		if (this->m_bintr_bg_compilation) {
-			options->translate_background_callback = [](std::function<void()>& callback) {
-				// This is called from inside the binary translator in the main thread,
-				// and the goal is to run the callback in a separate thread, to avoid
-				// blocking the main thread while the compilation step is running.
-				std::thread([callback = std::move(callback)]() {
-					// Run the callback in a separate thread
-					// This is useful for long-running compilation tasks
-					// that should not block the main thread.
-					// The callback will be called when the compilation is done.
-					// Note: This is a no-op if the callback is empty.
-					try {
-						if (callback)
-							callback();
-					} catch (const std::exception &e) {
-						String what = e.what();
-						ERR_PRINT(("Binary translation background compilation exception: " + what));
-					}
-				}).detach();
+			const uint64_t option_bits = uint64_t(this->m_bintr_register_caching) << 1 | uint64_t(this->m_bintr_automatic_nbit_as) << 2 | uint64_t(get_instructions_max() <= 0) << 3;
+			// Loads of the same program with the same options share one execute segment, and one compilation.
+			const uint64_t key = (std::hash<std::string_view>{}(binary_view) ^ option_bits) | 1;
+			// With tiering, the program is interpreted until enough VM calls have been made.
+			// Every instance counts its own calls, as only the first one constructs the segment.
+			const bool tiered = this->m_bintr_tier_threshold > 0;
+			this->m_bintr_key = key;
+			this->m_bintr_tier_key = tiered ? key : 0;
+			this->m_bintr_tier_calls = 0;
+			options->translate_background_callback = [this, key, tiered](std::function<void()> &callback) {
+				// This is called from inside the binary translator in the main thread, while the machine
+				// is being constructed, and the goal is to avoid blocking it while the compilation step is running.
+				if (tiered) {
+					CompileScheduler::get().defer(key, this, true, std::move(callback));
+				} else {
+					CompileScheduler::get().submit(key, this->m_bintr_priority, this, true, std::move(callback));
+				}
 			};
 		}
 #endif
 
 		this->m_machine = new machine_t{ binary_view, *options };
 		this->m_machine->set_options(std::move(options));
+
+		// Pin the shared execute segment to the program, so that it outlives this instance
+		if (this->m_program_data.is_valid() && !this->m_program_data->has_execute_segment()) {
+			this->m_program_data->set_execute_segment(
+				this->m_machine->memory.exec_segment_for(this->m_machine->memory.start_address()));
+		}
+#if defined(RISCV_BINARY_TRANSLATION) && defined(RISCV_LIBTCC)
+		// Only the first machine on a shared execute segment submits its compilation. Every machine
+		// on the segment owns it, so that it is only cancelled once none of them needs it. A program
+		// that pinned the segment owns it until the program is changed or freed.
+		if (this->m_bintr_key != 0) {
+			CompileScheduler::get().add_owner(this->m_bintr_key, this);
+			if (this->m_program_data.is_valid())
+				CompileScheduler::get().add_owner(this->m_bintr_key, this->m_program_data.ptr());
+		}
+#endif
+#if defined(RISCV_BINARY_TRANSLATION) && defined(RISCV_LIBTCC)
+		if (!jit_cache_path.is_empty() && !jit_cache_loaded) {
+			this->update_jit_cache(jit_cache_path, *buffer);
+		}
+#endif
 	} catch (const std::exception &e) {
 		ERR_PRINT(("Sandbox construction exception: " + std::string(e.what())).c_str());
 		this->m_machine = &dummy_machine;
@@ -557,10 +797,7 @@ bool Sandbox::load(const PackedByteArray *buffer, const std::vector<std::string>
 		machine_t &m = machine();
 
 		m.set_userdata(this);
-		m.set_printer([](const machine_t &m, const char *str, size_t len) {
-			Sandbox *sandbox = m.get_userdata<Sandbox>();
-			sandbox->print(String::utf8(str, len));
-		});
+		m.set_printer(sandbox_printer);
 
 		this->initialize_syscalls_runtime();
 
@@ -572,12 +809,16 @@ bool Sandbox::load(const PackedByteArray *buffer, const std::vector<std::string>
 		machine().setup_native_memory(MEMORY_SYSCALLS_BASE);
 		machine().arena().set_max_chunks(get_allocations_max());
 
+		// Restore the program as it was after main(), if a matching snapshot exists
+		const bool restored = argv_ptr == nullptr && this->restore_snapshot();
+
 		// Set up a Linux environment for the program
 		const std::vector<std::string> *argv = argv_ptr ? argv_ptr : &program_arguments;
-		m.setup_linux(*argv, { "LC_CTYPE=C", "LC_ALL=C", "TZ=UTC", "LD_LIBRARY_PATH=" });
+		if (!restored)
+			m.setup_linux(*argv, { "LC_CTYPE=C", "LC_ALL=C", "TZ=UTC", "LD_LIBRARY_PATH=" });
 
 		// Run the program through to its main() function
-		if (!this->m_resumable_mode) {
+		if (!this->m_resumable_mode && !restored) {
 			if (!this->get_precise_simulation()) {
 				if (get_instructions_max() <= 0) {
 					m.cpu.simulate_inaccurate(m.cpu.pc());
@@ -611,13 +852,7 @@ bool Sandbox::load(const PackedByteArray *buffer, const std::vector<std::string>
 		// We can't read them without having loaded the program first
 		// If the functions Array in the ELFScript object is empty, we will look for the API functions
 		if (!this->m_program_data->functions.is_empty()) {
-			// Cache the public API functions from the ELFScript object
-			for (int i = 0; i < this->m_program_data->functions.size(); i++) {
-				const Dictionary func = this->m_program_data->functions[i];
-				String name = func["name"];
-				const gaddr_t address = func.get("address", 0x0);
-				this->m_lookup.insert_or_assign(name.hash(), LookupEntry{ std::move(name), address });
-			}
+			this->cache_public_api_functions(this->m_program_data->functions);
 			this->m_program_data->update_public_api_functions();
 		}
 	}
@@ -706,11 +941,12 @@ Variant Sandbox::vmcall_fn(const StringName &function_name, const Variant **args
 	error.error = GDEXTENSION_CALL_OK;
 	return result;
 }
-void Sandbox::setup_arguments_native(gaddr_t arrayDataPtr, GuestVariant *v, const Variant **args, int argc) {
+void Sandbox::setup_arguments_native(gaddr_t arrayDataPtr, GuestVariant *v, const Variant **args, int argc, bool sret) {
 	// In this mode we will try to use registers when possible
 	// The stack is already set up from setup_arguments(), so we just need to set up the registers
 	machine_t &machine = this->machine();
-	int index = 11;
+	// The first argument register holds the return Variant, unless the value is returned in registers
+	int index = sret ? 11 : 10;
 	int flindex = 10;
 
 	for (size_t i = 0; i < argc; i++) {
@@ -815,7 +1051,7 @@ void Sandbox::setup_arguments_native(gaddr_t arrayDataPtr, GuestVariant *v, cons
 		throw std::runtime_error("Sandbox: Too many arguments for VM function call (register overflow)");
 	}
 }
-GuestVariant *Sandbox::setup_arguments(gaddr_t &sp, const Variant **args, int argc) {
+GuestVariant *Sandbox::setup_arguments(gaddr_t &sp, const Variant **args, int argc, bool sret) {
 	if (this->get_unboxed_arguments()) {
 		sp -= sizeof(GuestVariant) * (argc + 1);
 		sp &= ~gaddr_t(0xF); // re-align stack pointer
@@ -829,7 +1065,7 @@ GuestVariant *Sandbox::setup_arguments(gaddr_t &sp, const Variant **args, int ar
 
 		if (argc > 11)
 			throw std::runtime_error("Sandbox: Too many arguments for VM function call");
-		setup_arguments_native(arrayDataPtr, v, args, argc);
+		setup_arguments_native(arrayDataPtr, v, args, argc, sret);
 		// A0 is the return value (Variant) of the function
 		return &v[0];
 	}
@@ -841,7 +1077,9 @@ GuestVariant *Sandbox::setup_arguments(gaddr_t &sp, const Variant **args, int ar
 	// The offset to where the first Variant is stored
 	// The first argument is the return value, so we start at 1
 	// The rest are overflow arguments, which are pushed onto the stack
-	const int overflow_args = argc > 7 ? argc - 7 : 0;
+	const int first_reg = sret ? 11 : 10;
+	const int reg_args = sret ? 7 : 8;
+	const int overflow_args = argc > reg_args ? argc - reg_args : 0;
 
 	sp -= sizeof(GuestVariant) * (argc + 1) + sizeof(gaddr_t) * overflow_args;
 	sp &= ~gaddr_t(0xF); // re-align stack pointer
@@ -888,34 +1126,190 @@ GuestVariant *Sandbox::setup_arguments(gaddr_t &sp, const Variant **args, int ar
 			default:
 				g_arg.set(*this, *args[i], true);
 		}
-		if (i < 7) {
-			m_machine->cpu.reg(11 + i) = arrayDataPtr + (1 + i) * sizeof(GuestVariant);
+		if (i < reg_args) {
+			m_machine->cpu.reg(first_reg + i) = arrayDataPtr + (1 + i) * sizeof(GuestVariant);
 		} else {
-			overflow[i - 7] = arrayDataPtr + (1 + i) * sizeof(GuestVariant);
+			overflow[i - reg_args] = arrayDataPtr + (1 + i) * sizeof(GuestVariant);
 		}
 	}
 	// A0 is the return value (Variant) of the function
 	return &v[overflow_args];
 }
-Variant Sandbox::vmcall_internal(gaddr_t address, const Variant **args, int argc) {
-	this->m_current_state += 1;
-	const auto *beginptr = this->m_states.data();
-	const auto *endptr = this->m_states.data() + this->m_states.size();
-	if (UNLIKELY(this->m_current_state >= endptr)) {
-		ERR_PRINT("Too many VM calls in progress");
+void Sandbox::execute_guest(gaddr_t address) {
+	if (UNLIKELY(this->m_precise_simulation)) {
+		m_machine->set_instruction_counter(0);
+		uint64_t max_instr = get_instructions_max() << 20;
+		m_machine->set_max_instructions(max_instr ? max_instr : ~0ULL);
+		m_machine->cpu.jump(address);
+		m_machine->cpu.simulate_precise();
+		if (m_machine->instruction_limit_reached()) {
+			throw riscv::MachineTimeoutException(riscv::MAX_INSTRUCTIONS_REACHED,
+				"Instruction count limit reached", max_instr);
+		}
+	} else if (UNLIKELY(this->get_profiling())) {
+		LocalProfilingData &profdata = *this->m_local_profiling_data;
+		m_machine->cpu.jump(address);
+		do {
+			const int32_t next = std::max(int32_t(1), int32_t(profdata.profiling_interval) - int32_t(profdata.profiler_icounter_accumulator));
+			m_machine->simulate<false>(next, 0u);
+			if (m_machine->instruction_limit_reached()) {
+				profdata.profiler_icounter_accumulator = 0;
+				profdata.visited.push_back(m_machine->cpu.pc());
+			}
+		} while (m_machine->instruction_limit_reached());
+		// update the accumulator with the remaining instructions
+		profdata.profiler_icounter_accumulator += m_machine->instruction_counter();
+		if (profdata.profiler_icounter_accumulator >= profdata.profiling_interval) {
+			profdata.profiler_icounter_accumulator = 0;
+		}
+		if (!profdata.visited.empty()) {
+			ProfilingData &gprofdata = *this->m_profiling_data;
+			// Determine ELF path
+			std::string_view path = "";
+			if (this->m_program_data.is_valid()) {
+				path = this->m_program_data->get_std_path();
+			}
+			// Update the global profiler
+			{
+				std::scoped_lock lock(profiling_mutex);
+				ProfilingState &gprofstate = gprofdata.state[path];
+				// Add all the local known functions to the global state,
+				// to aid lookup in the profiler later on
+				if (gprofstate.lookup.size() < this->m_lookup.size()) {
+					gprofstate.lookup.clear();
+					for (const auto [hash, entry] : this->m_lookup) {
+						gprofstate.lookup.push_back(entry);
+					}
+				}
+				// Update the global visited map
+				std::unordered_map<gaddr_t, int> &hotspots = gprofstate.hotspots;
+				for (const gaddr_t address : profdata.visited) {
+					hotspots[address]++;
+				}
+			}
+			profdata.visited.clear();
+		}
+	} else if (get_instructions_max() <= 0) {
+		m_machine->cpu.simulate_inaccurate(address);
+	} else {
+		m_machine->simulate_with(get_instructions_max() << 20, 0u, address);
+	}
+}
+bool Sandbox::is_unboxed_return_type(Variant::Type type) {
+	switch (type) {
+		case Variant::NIL:
+		case Variant::BOOL:
+		case Variant::INT:
+		case Variant::FLOAT:
+		case Variant::VECTOR2:
+		case Variant::VECTOR2I:
+		case Variant::VECTOR3:
+		case Variant::VECTOR3I:
+		case Variant::VECTOR4:
+		case Variant::VECTOR4I:
+		case Variant::COLOR:
+		case Variant::OBJECT:
+			return true;
+		default:
+			return false;
+	}
+}
+Variant Sandbox::unboxed_return_value(Variant::Type type) const {
+	// Values are returned according to the RISC-V calling convention:
+	// integers in A0, doubles in FA0, two-float structs in FA0 and FA1,
+	// and other structs up to 16 bytes packed into A0 and A1.
+	const riscv::CPU<RISCV_ARCH> &cpu = m_machine->cpu;
+	const uint64_t a0 = cpu.reg(riscv::REG_ARG0);
+	const uint64_t a1 = cpu.reg(riscv::REG_ARG1);
+	const auto lo = [](uint64_t reg) { int32_t v; std::memcpy(&v, &reg, 4); return v; };
+	const auto hi = [](uint64_t reg) { int32_t v; std::memcpy(&v, (const char *)&reg + 4, 4); return v; };
+	const auto lof = [](uint64_t reg) { float v; std::memcpy(&v, &reg, 4); return v; };
+	const auto hif = [](uint64_t reg) { float v; std::memcpy(&v, (const char *)&reg + 4, 4); return v; };
+	switch (type) {
+		case Variant::BOOL:
+			return (a0 & 0xFF) != 0;
+		case Variant::INT:
+			return int64_t(a0);
+		case Variant::FLOAT:
+			return cpu.registers().getfl(riscv::REG_FA0).f64;
+		case Variant::VECTOR2:
+			return Vector2(cpu.registers().getfl(riscv::REG_FA0).f32[0], cpu.registers().getfl(riscv::REG_FA1).f32[0]);
+		case Variant::VECTOR2I:
+			return Vector2i(lo(a0), hi(a0));
+		case Variant::VECTOR3:
+			return Vector3(lof(a0), hif(a0), lof(a1));
+		case Variant::VECTOR3I:
+			return Vector3i(lo(a0), hi(a0), lo(a1));
+		case Variant::VECTOR4:
+			return Vector4(lof(a0), hif(a0), lof(a1), hif(a1));
+		case Variant::VECTOR4I:
+			return Vector4i(lo(a0), hi(a0), lo(a1), hi(a1));
+		case Variant::COLOR:
+			return Color(lof(a0), hif(a0), lof(a1), hif(a1));
+		case Variant::OBJECT: {
+			if (a0 == 0)
+				return Variant();
+			// Only objects known to this call may be returned
+			if (!this->is_scoped_object(reinterpret_cast<godot::Object *>(a0))) {
+				ERR_PRINT("Object is not scoped");
+				throw std::runtime_error("Object is not scoped");
+			}
+			return reinterpret_cast<godot::Object *>(a0);
+		}
+		default:
+			return Variant();
+	}
+}
+Sandbox::CurrentState *Sandbox::push_state() {
+	if (UNLIKELY(this->m_level >= this->m_max_level)) {
+		ERR_PRINT("Too many VM calls in progress (call_depth_max = " + itos(this->m_max_level) + ")");
 		this->m_exceptions++;
 		this->m_global_exceptions++;
-		this->m_current_state -= 1;
+		return nullptr;
+	}
+	if (UNLIKELY(this->m_level == 0 && !this->m_forks.empty())) {
+		// The parent's pages are shared with its forks, and are not copy-on-write for the parent
+		ERR_PRINT("Cannot make a VM call into a sandbox that has been forked from. It is frozen until its forks are gone.");
+		this->m_exceptions++;
+		this->m_global_exceptions++;
+		return nullptr;
+	}
+	this->m_level += 1;
+	if (UNLIKELY(this->m_level >= this->m_states.size())) {
+		// Growing a deque at the end does not invalidate references to the existing states
+		this->m_states.emplace_back().initialize(this->m_level, this->m_max_refs);
+	}
+	this->m_current_state = &this->m_states[this->m_level];
+	return this->m_current_state;
+}
+void Sandbox::pop_state() {
+	if (UNLIKELY(!this->m_array_views.empty())) {
+		this->release_array_views(this->m_level);
+	}
+	this->m_level -= 1;
+	this->m_current_state = &this->m_states[this->m_level];
+}
+Variant Sandbox::vmcall_internal(gaddr_t address, const Variant **args, int argc, const SandboxCallSite *call_site) {
+	CurrentState *current = this->push_state();
+	if (UNLIKELY(current == nullptr)) {
 		return Variant();
 	}
 
-	CurrentState &state = *this->m_current_state;
-	const bool is_reentrant_call = (this->m_current_state - beginptr) > 1;
+	CurrentState &state = *current;
+	const bool is_reentrant_call = this->m_level > 1;
 	state.reset();
 
 	// Call statistics
 	this->m_calls_made++;
 	Sandbox::m_global_calls_made++;
+#if defined(RISCV_BINARY_TRANSLATION) && defined(RISCV_LIBTCC)
+	if (UNLIKELY(this->m_bintr_tier_key != 0))
+		this->count_tiered_calls(1);
+#endif
+
+	// Some functions return their value directly in registers
+	const Variant::Type unboxed_return = this->unboxed_return_type_of(address);
+	const bool sret = unboxed_return == Variant::VARIANT_MAX;
 
 	try {
 		GuestVariant *retvar = nullptr;
@@ -927,66 +1321,9 @@ Variant Sandbox::vmcall_internal(gaddr_t address, const Variant **args, int argc
 			// reset the stack pointer to its initial location
 			sp = m_machine->memory.stack_initial();
 			// set up each argument, and return value
-			retvar = this->setup_arguments(sp, args, argc);
+			retvar = call_site ? call_site->setup_arguments(*this, sp, args, argc) : this->setup_arguments(sp, args, argc, sret);
 			// execute!
-			if (UNLIKELY(this->m_precise_simulation)) {
-				m_machine->set_instruction_counter(0);
-				uint64_t max_instr = get_instructions_max() << 20;
-				m_machine->set_max_instructions(max_instr ? max_instr : ~0ULL);
-				m_machine->cpu.jump(address);
-				m_machine->cpu.simulate_precise();
-				if (m_machine->instruction_limit_reached()) {
-					throw riscv::MachineTimeoutException(riscv::MAX_INSTRUCTIONS_REACHED,
-						"Instruction count limit reached", max_instr);
-				}
-			} else if (UNLIKELY(this->get_profiling())) {
-				LocalProfilingData &profdata = *this->m_local_profiling_data;
-				m_machine->cpu.jump(address);
-				do {
-					const int32_t next = std::max(int32_t(1), int32_t(profdata.profiling_interval) - int32_t(profdata.profiler_icounter_accumulator));
-					m_machine->simulate<false>(next, 0u);
-					if (m_machine->instruction_limit_reached()) {
-						profdata.profiler_icounter_accumulator = 0;
-						profdata.visited.push_back(m_machine->cpu.pc());
-					}
-				} while (m_machine->instruction_limit_reached());
-				// update the accumulator with the remaining instructions
-				profdata.profiler_icounter_accumulator += m_machine->instruction_counter();
-				if (profdata.profiler_icounter_accumulator >= profdata.profiling_interval) {
-					profdata.profiler_icounter_accumulator = 0;
-				}
-				if (!profdata.visited.empty()) {
-					ProfilingData &gprofdata = *this->m_profiling_data;
-					// Determine ELF path
-					std::string_view path = "";
-					if (this->m_program_data.is_valid()) {
-						path = this->m_program_data->get_std_path();
-					}
-					// Update the global profiler
-					{
-						std::scoped_lock lock(profiling_mutex);
-						ProfilingState &gprofstate = gprofdata.state[path];
-						// Add all the local known functions to the global state,
-						// to aid lookup in the profiler later on
-						if (gprofstate.lookup.size() < this->m_lookup.size()) {
-							gprofstate.lookup.clear();
-							for (const auto [hash, entry] : this->m_lookup) {
-								gprofstate.lookup.push_back(entry);
-							}
-						}
-						// Update the global visited map
-						std::unordered_map<gaddr_t, int> &hotspots = gprofstate.hotspots;
-						for (const gaddr_t address : profdata.visited) {
-							hotspots[address]++;
-						}
-					}
-					profdata.visited.clear();
-				}
-			} else if (get_instructions_max() <= 0) {
-				m_machine->cpu.simulate_inaccurate(address);
-			} else {
-				m_machine->simulate_with(get_instructions_max() << 20, 0u, address);
-			}
+			this->execute_guest(address);
 		} else {
 			riscv::Registers<RISCV_ARCH> regs;
 			regs = cpu.registers();
@@ -995,16 +1332,23 @@ Variant Sandbox::vmcall_internal(gaddr_t address, const Variant **args, int argc
 			// we need to make some stack room
 			sp -= 16u;
 			// set up each argument, and return value
-			retvar = this->setup_arguments(sp, args, argc);
+			retvar = call_site ? call_site->setup_arguments(*this, sp, args, argc) : this->setup_arguments(sp, args, argc, sret);
 			// execute preemption! (precise simulation not supported)
 			uint64_t max_instr = get_instructions_max() << 20;
 			cpu.preempt_internal(regs, true, true, address, max_instr ? max_instr : ~0ULL);
 		}
 
-		// Treat return value as pointer to Variant
-		Variant result = retvar->toVariant(*this);
+		Variant result;
+		if (!sret) {
+			result = this->unboxed_return_value(unboxed_return);
+		} else if (call_site) {
+			result = call_site->decode_return(*this, *retvar);
+		} else {
+			// Treat return value as pointer to Variant
+			result = retvar->toVariant(*this);
+		}
 		// Restore the previous state
-		this->m_current_state -= 1;
+		this->pop_state();
 		return result;
 
 	} catch (const std::exception &e) {
@@ -1015,10 +1359,137 @@ Variant Sandbox::vmcall_internal(gaddr_t address, const Variant **args, int argc
 		this->handle_exception(address);
 		// TODO: Free the function arguments and return value? Will help keep guest memory clean
 
-		this->m_current_state -= 1;
+		this->pop_state();
 		return Variant();
 	}
 }
+template <typename ArgumentsFn, typename ResultFn>
+int64_t Sandbox::vmcall_batch_internal(gaddr_t address, int64_t count, ArgumentsFn &&arguments_for, ResultFn &&result_for) {
+	// Batches enter the VM once, and cannot be nested inside other VM calls
+	if (this->is_in_vmcall()) {
+		ERR_PRINT("Cannot make a batched VM call while a VM call is in progress.");
+		return 0;
+	}
+	CurrentState *current = this->push_state();
+	if (UNLIKELY(current == nullptr)) {
+		return 0;
+	}
+	CurrentState &state = *current;
+
+	const Variant::Type unboxed_return = this->unboxed_return_type_of(address);
+	const bool sret = unboxed_return == Variant::VARIANT_MAX;
+
+	int64_t completed = 0;
+	bool threw = false;
+	try {
+		riscv::CPU<RISCV_ARCH> &cpu = m_machine->cpu;
+		auto &sp = cpu.reg(riscv::REG_SP);
+		std::array<const Variant *, 16> argptrs;
+		for (; completed < count; completed++) {
+			const int64_t i = completed;
+			// Scoped Variants, objects and array views are only valid for a single call
+			if (UNLIKELY(!this->m_array_views.empty())) {
+				this->release_array_views(this->m_level);
+			}
+			state.reset();
+			const int argc = arguments_for(i, argptrs);
+			cpu.reg(riscv::REG_RA) = m_machine->memory.exit_address();
+			sp = m_machine->memory.stack_initial();
+			GuestVariant *retvar = this->setup_arguments(sp, argptrs.data(), argc, sret);
+			this->execute_guest(address);
+			result_for(i, sret ? retvar->toVariant(*this) : this->unboxed_return_value(unboxed_return));
+		}
+	} catch (const std::exception &e) {
+		if (Engine::get_singleton()->is_editor_hint()) {
+			// Throttle exceptions in the sandbox when calling from the editor
+			this->m_throttled += EDITOR_THROTTLE;
+		}
+		// The remaining calls in the batch are skipped
+		this->handle_exception(address);
+		threw = true;
+	}
+	this->pop_state();
+
+	// Call statistics, including the call that threw
+	const int64_t calls = completed + (threw ? 1 : 0);
+	this->m_calls_made += calls;
+	Sandbox::m_global_calls_made += calls;
+#if defined(RISCV_BINARY_TRANSLATION) && defined(RISCV_LIBTCC)
+	if (UNLIKELY(this->m_bintr_tier_key != 0))
+		this->count_tiered_calls(calls);
+#endif
+	return completed;
+}
+Array Sandbox::vmcall_batch(const String &function, const Array &argument_arrays) {
+	Array results;
+	const gaddr_t address = cached_address_of(function.hash(), function);
+	if (address == 0x0) {
+		ERR_PRINT("Function not found in the guest: " + function);
+		return results;
+	}
+	// The arguments are checked before entering the VM, so that host errors are not guest exceptions
+	for (int64_t i = 0; i < argument_arrays.size(); i++) {
+		if (argument_arrays[i].get_type() != Variant::ARRAY) {
+			ERR_PRINT("Sandbox: Batched call " + itos(i) + " has no argument array.");
+			return results;
+		}
+		if (Array(argument_arrays[i]).size() > 16) {
+			ERR_PRINT("Sandbox: Too many arguments for batched call " + itos(i));
+			return results;
+		}
+	}
+	results.resize(argument_arrays.size());
+	const int64_t completed = this->vmcall_batch_internal(address, argument_arrays.size(),
+		[&](int64_t i, std::array<const Variant *, 16> &argptrs) -> int {
+			const Array args = argument_arrays[i];
+			for (int j = 0; j < args.size(); j++) {
+				argptrs[j] = &args[j];
+			}
+			return args.size();
+		},
+		[&](int64_t i, Variant &&result) {
+			results[i] = std::move(result);
+		});
+	// Calls after an exception were skipped
+	results.resize(completed);
+	return results;
+}
+PackedFloat64Array Sandbox::vmcall_batch_packed(const String &function, const PackedFloat64Array &arguments, int arguments_per_call, int64_t call_count) {
+	PackedFloat64Array results;
+	const gaddr_t address = cached_address_of(function.hash(), function);
+	if (address == 0x0) {
+		ERR_PRINT("Function not found in the guest: " + function);
+		return results;
+	}
+	if (arguments_per_call < 0 || arguments_per_call > 16 || (arguments_per_call > 0 && arguments.size() % arguments_per_call != 0)) {
+		ERR_PRINT("Sandbox: Invalid number of arguments per batched call: " + itos(arguments_per_call));
+		return results;
+	}
+	// Without arguments, the number of calls cannot be derived from them
+	const int64_t count = call_count >= 0 ? call_count : (arguments_per_call > 0 ? arguments.size() / arguments_per_call : -1);
+	if (count < 0 || int64_t(arguments.size()) != count * arguments_per_call) {
+		ERR_PRINT("Sandbox: Invalid number of batched calls: " + itos(count));
+		return results;
+	}
+	results.resize(count);
+	const double *input = arguments.ptr();
+	double *output = results.ptrw();
+	std::array<Variant, 16> args;
+	const int64_t completed = this->vmcall_batch_internal(address, count,
+		[&](int64_t i, std::array<const Variant *, 16> &argptrs) -> int {
+			for (int j = 0; j < arguments_per_call; j++) {
+				args[j] = input[i * arguments_per_call + j];
+				argptrs[j] = &args[j];
+			}
+			return arguments_per_call;
+		},
+		[&](int64_t i, Variant &&result) {
+			output[i] = double(result);
+		});
+	// Calls after an exception were skipped
+	results.resize(completed);
+	return results;
+}
 Variant Sandbox::vmcallable(String function, Array args) {
 	const gaddr_t address = cached_address_of(function.hash(), function);
 	if (address == 0x0) {
@@ -1035,6 +1506,20 @@ Variant Sandbox::vmcallable_address(gaddr_t address, Array args) {
 	call->init(this, address, std::move(args));
 	return Callable(call);
 }
+Ref<SandboxCallSite> Sandbox::create_call_site(const String &function, const PackedInt32Array &argument_types, int return_type) {
+	const gaddr_t address = cached_address_of(function.hash(), function);
+	if (address == 0x0) {
+		ERR_PRINT("Function not found in the guest: " + function);
+		return Ref<SandboxCallSite>();
+	}
+
+	Ref<SandboxCallSite> call_site;
+	call_site.instantiate();
+	if (!call_site->init(this, address, argument_types, Variant::Type(return_type))) {
+		return Ref<SandboxCallSite>();
+	}
+	return call_site;
+}
 void RiscvCallable::call(const Variant **p_arguments, int p_argcount, Variant &r_return_value, GDExtensionCallError &r_call_error) const {
 	if (m_varargs_base_count > 0) {
 		// We may be receiving extra arguments, so we will fill at the end of m_varargs_ptrs array
@@ -1092,50 +1577,115 @@ bool Sandbox::has_function(const StringName &p_function) const {
 	return address != 0x0;
 }
 
-void Sandbox::add_cached_address(const String &name, gaddr_t address) const {
+void Sandbox::add_cached_address(const String &name, gaddr_t address, Variant::Type unboxed_return) const {
 	m_lookup.insert_or_assign(name.hash(), LookupEntry{ name, address });
+	if (unboxed_return != Variant::VARIANT_MAX) {
+		m_unboxed_returns.insert_or_assign(address, unboxed_return);
+	}
+}
+
+// A method handle is the interned class name in the upper 16 bits, and the interned method name in the lower 16 bits
+static_assert(Sandbox::MAX_INTERNED_NAMES < 0x10000, "Interned name handles must fit in 16 bits");
+
+uint32_t Sandbox::resolve_method_handle(godot::Object *obj, const String &method) {
+	const StringName method_name = method;
+	if (UNLIKELY(!obj->has_method(method_name))) {
+		ERR_PRINT("Method not found: " + obj->get_class() + "::" + method);
+		throw std::runtime_error("Method not found: " + std::string(method.utf8().ptr()));
+	}
+	const uint32_t class_handle = intern_name(obj->get_class());
+	return class_handle << 16 | intern_name(method_name);
+}
+
+const StringName &Sandbox::get_method_handle(godot::Object *obj, uint32_t handle) const {
+	// Throws on an invalid handle
+	const StringName &class_name = get_interned_name(handle >> 16);
+	const StringName &method = get_interned_name(handle & 0xFFFF);
+	// The method was found on this class, and may not exist on others
+	if (UNLIKELY(!obj->is_class(class_name))) {
+		ERR_PRINT("Method handle of " + String(class_name) + "::" + String(method) + " called on " + obj->get_class());
+		throw std::runtime_error("Method handle called on an object of another class");
+	}
+	return method;
+}
+
+uint32_t Sandbox::intern_name(const StringName &name) {
+	if (const uint32_t *handle = m_interned_name_lookup.getptr(name))
+		return *handle;
+	if (UNLIKELY(m_interned_names.size() >= MAX_INTERNED_NAMES)) {
+		ERR_PRINT("Maximum number of interned names reached.");
+		throw std::runtime_error("Maximum number of interned names reached");
+	}
+	m_interned_names.push_back(name);
+	const uint32_t handle = m_interned_names.size();
+	m_interned_name_lookup.insert(name, handle);
+	return handle;
+}
+
+const StringName &Sandbox::get_interned_name(uint32_t handle) const {
+	if (UNLIKELY(handle == 0 || handle > m_interned_names.size())) {
+		ERR_PRINT("Invalid interned name: " + itos(handle));
+		throw std::runtime_error("Invalid interned name: " + std::to_string(handle));
+	}
+	return m_interned_names[handle - 1];
 }
 
 //-- Scoped objects and variants --//
 
 unsigned Sandbox::add_scoped_variant(const Variant *value) const {
 	CurrentState &st = this->state();
+	if (&st == &this->m_states[0]) {
+		// Variants added during initialization are permanent
+		const int32_t slot = st.insert_permanent(value);
+		if (slot < 0) {
+			ERR_PRINT("Maximum number of scoped variants reached.");
+			throw std::runtime_error("Maximum number of scoped variants reached.");
+		}
+		return make_variant_handle(true, slot, st.generations[slot]);
+	}
 	if (st.scoped_variants.size() >= st.variants.capacity()) {
 		ERR_PRINT("Maximum number of scoped variants reached.");
 		throw std::runtime_error("Maximum number of scoped variants reached.");
 	}
 	st.scoped_variants.push_back(value);
-	if (&st != &this->m_states[0])
-		return int32_t(st.scoped_variants.size()) - 1;
-	else
-		return -int32_t(st.scoped_variants.size());
+	return make_variant_handle(false, st.scoped_variants.size() - 1, st.generation);
 }
 unsigned Sandbox::create_scoped_variant(Variant &&value) const {
 	CurrentState &st = this->state();
+	if (&st == &this->m_states[0]) {
+		// Variants created during initialization are permanent
+		const int32_t slot = st.append_permanent(std::move(value));
+		if (slot < 0) {
+			ERR_PRINT("Maximum number of scoped variants reached.");
+			throw std::runtime_error("Maximum number of scoped variants reached.");
+		}
+		return make_variant_handle(true, slot, st.generations[slot]);
+	}
 	if (st.scoped_variants.size() >= st.variants.capacity()) {
 		ERR_PRINT("Maximum number of scoped variants reached.");
 		throw std::runtime_error("Maximum number of scoped variants reached.");
 	}
 	st.append(std::move(value));
-	if (&st != &this->m_states[0])
-		return int32_t(st.scoped_variants.size()) - 1;
-	else
-		return -int32_t(st.scoped_variants.size());
+	return make_variant_handle(false, st.scoped_variants.size() - 1, st.generation);
 }
 std::optional<const Variant *> Sandbox::get_scoped_variant(int32_t index) const noexcept {
-	if (index >= 0 && index < state().scoped_variants.size()) {
-		return state().scoped_variants[index];
-	} else if (index < 0) {
-		// Negative index is access into initialization state
-		index = -index - 1;
-		auto &init_state = this->m_states[0];
-		if (index < init_state.scoped_variants.size()) {
-			return init_state.scoped_variants[index];
+	const uint32_t handle = uint32_t(index);
+	const uint32_t slot = handle & VARIANT_HANDLE_SLOT_MASK;
+	const uint16_t generation = (handle >> 16) & VARIANT_HANDLE_GENERATION_MASK;
+	if ((handle & VARIANT_HANDLE_PERMANENT) == 0) {
+		const CurrentState &st = this->state();
+		if (generation == st.generation && slot < st.scoped_variants.size()) {
+			return st.scoped_variants[slot];
 		}
-		ERR_PRINT("Invalid permanent variant index: " + itos(index));
+		ERR_PRINT("Invalid scoped variant index: " + itos(index));
 		return std::nullopt;
 	}
-	ERR_PRINT("Invalid scoped variant index: " + itos(index));
+	// Permanent handles access the initialization state
+	const CurrentState &perm_state = this->m_states[0];
+	if (slot < perm_state.scoped_variants.size() && generation == perm_state.generations[slot]) {
+		return perm_state.scoped_variants[slot];
+	}
+	ERR_PRINT("Invalid permanent variant index: " + itos(index));
 	return std::nullopt;
 }
 Variant &Sandbox::get_mutable_scoped_variant(int32_t index) {
@@ -1145,11 +1695,9 @@ Variant &Sandbox::get_mutable_scoped_variant(int32_t index) {
 		throw std::runtime_error("Invalid scoped variant index.");
 	}
 	const Variant *var = var_opt.value();
-	// Find the variant in the variants list
-	auto it = std::find_if(state().variants.begin(), state().variants.end(), [var](const Variant &v) {
-		return &v == var;
-	});
-	if (it == state().variants.end()) {
+	// Check if the variant is owned by the current state
+	Variant *owned = state().find_owned_variant(var);
+	if (owned == nullptr) {
 		// Create a new variant in the list using the existing one, and return it
 		if (state().variants.size() >= state().variants.capacity()) {
 			ERR_PRINT("Maximum number of scoped variants reached.");
@@ -1158,10 +1706,10 @@ Variant &Sandbox::get_mutable_scoped_variant(int32_t index) {
 		state().append(Variant(*var));
 		return state().variants.back();
 	}
-	return *it;
+	return *owned;
 }
 unsigned Sandbox::create_permanent_variant(unsigned idx) {
-	if (int32_t(idx) < 0) {
+	if (is_permanent_variant(idx)) {
 		// It's already a permanent variant
 		return idx;
 	}
@@ -1171,42 +1719,48 @@ unsigned Sandbox::create_permanent_variant(unsigned idx) {
 		throw std::runtime_error("Could not make permanent: Invalid scoped variant index " + std::to_string(idx));
 	}
 	const Variant *var = var_opt.value();
-	// Find the variant in the variants list
-	auto it = std::find_if(state().variants.begin(), state().variants.end(), [var](const Variant &v) {
-		return &v == var;
-	});
+	// Check if the variant is owned by the current state
+	Variant *owned = state().find_owned_variant(var);
 
 	CurrentState &perm_state = this->m_states[0];
-	if (perm_state.variants.size() >= perm_state.variants.capacity()) {
+	// Move the variant to the permanent list, leave the old one in the scoped list
+	const int32_t slot = perm_state.append_permanent(owned ? std::move(*owned) : var->duplicate());
+	if (slot < 0) {
 		ERR_PRINT("Maximum number of scoped variants in permanent state reached.");
 		// Just return the old scoped variant
 		return idx;
 	}
-
-	if (it == state().variants.end()) {
-		// Create a new variant in the permanent list
-		perm_state.append(var->duplicate());
-	} else {
-		// Move the variant to the permanent list, leave the old one in the scoped list
-		perm_state.append(std::move(*it));
-	}
-	unsigned perm_idx = perm_state.variants.size() - 1;
-	// Return the index of the new permanent variant converted to negative
-	return -int32_t(perm_idx) - 1;
+	return make_variant_handle(true, slot, perm_state.generations[slot]);
 }
 void Sandbox::assign_permanent_variant(int32_t idx, Variant &&val) {
-	if (idx < 0) {
-		// It's a permanent variant, verify the index
-		idx = -idx - 1;
-		if (idx < this->m_states[0].variants.size()) {
-			this->m_states[0].variants[idx] = std::move(val);
-			return;
+	if (is_permanent_variant(idx)) {
+		std::optional<const Variant *> var_opt = get_scoped_variant(idx);
+		if (var_opt.has_value()) {
+			CurrentState &perm_state = this->m_states[0];
+			const uint32_t slot = uint32_t(idx) & VARIANT_HANDLE_SLOT_MASK;
+			if (Variant *owned = perm_state.find_owned_variant(var_opt.value())) {
+				*owned = std::move(val);
+				return;
+			}
+			// The slot references a Variant we don't own, so give it its own storage
+			if (perm_state.variants.size() < perm_state.variants.capacity()) {
+				perm_state.variants.push_back(std::move(val));
+				perm_state.scoped_variants[slot] = &perm_state.variants.back();
+				return;
+			}
 		}
 	}
 	// It's either a scoped (temporary) variant, or invalid
 	ERR_PRINT("Invalid permanent variant index.");
 	throw std::runtime_error("Invalid permanent variant index: " + std::to_string(idx));
 }
+void Sandbox::free_permanent_variant(int32_t idx) {
+	if (!is_permanent_variant(idx) || !get_scoped_variant(idx).has_value()) {
+		ERR_PRINT("Invalid permanent variant index.");
+		throw std::runtime_error("Invalid permanent variant index: " + std::to_string(idx));
+	}
+	this->m_states[0].release_permanent(uint32_t(idx) & VARIANT_HANDLE_SLOT_MASK);
+}
 unsigned Sandbox::try_reuse_assign_variant(int32_t src_idx, const Variant &src_var, int32_t assign_to_idx, const Variant &new_value) {
 	if (this->is_permanent_variant(assign_to_idx)) {
 		// The Variant is permanent, so we need to assign it directly.
@@ -1223,12 +1777,25 @@ unsigned Sandbox::try_reuse_assign_variant(int32_t src_idx, const Variant &src_v
 	}
 }
 
+unsigned Sandbox::get_free_references() const noexcept {
+	const CurrentState &st = this->state();
+	unsigned variants;
+	if (&st == &this->m_states[0]) {
+		// Permanent slots can also be reused after they have been freed
+		const size_t used = std::max(st.variants.size(), st.scoped_variants.size());
+		variants = st.free_slots.size() + std::min<size_t>(st.variants.capacity() - used, MAX_VARIANT_SLOTS - st.scoped_variants.size());
+	} else {
+		variants = st.variants.capacity() - st.scoped_variants.size();
+	}
+	const unsigned objects = st.scoped_objects.size() < this->m_max_refs ? this->m_max_refs - st.scoped_objects.size() : 0;
+	return std::min(variants, objects);
+}
 void Sandbox::add_scoped_object(const void *ptr) {
 	if (state().scoped_objects.size() >= this->m_max_refs) {
 		ERR_PRINT("Maximum number of scoped objects reached.");
 		throw std::runtime_error("Maximum number of scoped objects reached.");
 	}
-	state().scoped_objects.push_back(reinterpret_cast<uintptr_t>(ptr));
+	state().scoped_objects.insert(reinterpret_cast<uintptr_t>(ptr));
 }
 
 //-- Properties --//
@@ -1337,6 +1904,9 @@ bool Sandbox::set_property(const StringName &name, const Variant &value) {
 	if (name == property_names[PROP_REFERENCES_MAX]) {
 		set_max_refs(value);
 		return true;
+	} else if (name == property_names[PROP_CALL_DEPTH_MAX]) {
+		set_max_call_depth(value);
+		return true;
 	} else if (name == property_names[PROP_MEMORY_MAX]) {
 		set_memory_max(value);
 		return true;
@@ -1352,6 +1922,9 @@ bool Sandbox::set_property(const StringName &name, const Variant &value) {
 	} else if (name == property_names[PROP_PRECISE_SIMULATION]) {
 		set_precise_simulation(value);
 		return true;
+	} else if (name == property_names[PROP_DEFERRED_WRITES]) {
+		set_deferred_writes(value);
+		return true;
 #ifdef RISCV_LIBTCC
 	} else if (name == property_names[PROP_BINTR_NBIT_AS]) {
 		set_binary_translation_automatic_nbit_as(value);
@@ -1388,6 +1961,9 @@ bool Sandbox::get_property(const StringName &name, Variant &r_ret) {
 	if (name == property_names[PROP_REFERENCES_MAX]) {
 		r_ret = get_max_refs();
 		return true;
+	} else if (name == property_names[PROP_CALL_DEPTH_MAX]) {
+		r_ret = get_max_call_depth();
+		return true;
 	} else if (name == property_names[PROP_MEMORY_MAX]) {
 		r_ret = get_memory_max();
 		return true;
@@ -1403,6 +1979,9 @@ bool Sandbox::get_property(const StringName &name, Variant &r_ret) {
 	} else if (name == property_names[PROP_PRECISE_SIMULATION]) {
 		r_ret = get_precise_simulation();
 		return true;
+	} else if (name == property_names[PROP_DEFERRED_WRITES]) {
+		r_ret = get_deferred_writes();
+		return true;
 #ifdef RISCV_LIBTCC
 	} else if (name == property_names[PROP_BINTR_NBIT_AS]) {
 		r_ret = this->m_bintr_automatic_nbit_as;
@@ -1549,30 +2128,113 @@ Variant SandboxProperty::get(const Sandbox &sandbox) const {
 
 void Sandbox::CurrentState::initialize(unsigned level, unsigned max_refs) {
 	(void)level;
+	// Reserve up front, so that the vectors are not reallocated during calls
 	this->variants.reserve(max_refs);
+	this->scoped_variants.reserve(max_refs);
+	this->scoped_objects.reserve(max_refs);
 }
 void Sandbox::CurrentState::reinitialize(unsigned level, unsigned max_refs) {
-	(void)level;
-	this->variants.reserve(max_refs);
+	this->initialize(level, max_refs);
 	this->variants.clear();
 	this->scoped_objects.clear();
 	this->scoped_variants.clear();
+	this->generations.clear();
+	this->free_slots.clear();
+	this->dictionary_range = DictionaryRange();
+	this->generation = next_variant_generation(this->generation);
+}
+int32_t Sandbox::CurrentState::append_permanent(Variant &&value) {
+	if (!this->free_slots.empty()) {
+		const uint32_t slot = this->free_slots.back();
+		// Reuse the storage of the freed Variant, if we own it
+		if (Variant *owned = this->find_owned_variant(this->scoped_variants[slot])) {
+			*owned = std::move(value);
+		} else if (this->variants.size() < this->variants.capacity()) {
+			this->variants.push_back(std::move(value));
+			this->scoped_variants[slot] = &this->variants.back();
+		} else {
+			return -1;
+		}
+		this->free_slots.pop_back();
+		return slot;
+	}
+	if (this->variants.size() >= this->variants.capacity() || this->scoped_variants.size() >= MAX_VARIANT_SLOTS) {
+		return -1;
+	}
+	this->append(std::move(value));
+	this->generations.push_back(1);
+	return this->scoped_variants.size() - 1;
+}
+int32_t Sandbox::CurrentState::insert_permanent(const Variant *value) {
+	if (!this->free_slots.empty()) {
+		const uint32_t slot = this->free_slots.back();
+		this->free_slots.pop_back();
+		// Storage owned by the freed slot would be lost if the slot referenced the Variant
+		// instead, so the slot keeps its storage and holds a copy
+		if (Variant *owned = this->find_owned_variant(this->scoped_variants[slot])) {
+			*owned = *value;
+		} else {
+			this->scoped_variants[slot] = value;
+		}
+		return slot;
+	}
+	if (this->scoped_variants.size() >= this->variants.capacity() || this->scoped_variants.size() >= MAX_VARIANT_SLOTS) {
+		return -1;
+	}
+	this->scoped_variants.push_back(value);
+	this->generations.push_back(1);
+	return this->scoped_variants.size() - 1;
+}
+void Sandbox::CurrentState::release_permanent(uint32_t slot) {
+	// Release the value now, but keep the storage for the next permanent Variant
+	if (Variant *owned = this->find_owned_variant(this->scoped_variants[slot])) {
+		*owned = Variant();
+	} else {
+		this->scoped_variants[slot] = nullptr;
+	}
+	this->generations[slot] = next_variant_generation(this->generations[slot]);
+	this->free_slots.push_back(slot);
 }
 bool Sandbox::CurrentState::is_mutable_variant(const Variant &var) const {
 	// Check if the address of the variant is within the range of the current state std::vector
 	const Variant *ptr = &var;
-	return ptr >= &variants[0] && ptr < &variants[0] + variants.size();
+	return ptr >= variants.data() && ptr < variants.data() + variants.size();
 }
 
 void Sandbox::set_max_refs(uint32_t max) {
-	this->m_max_refs = max;
-	// If we are not in a call, reset the states
-	if (!this->is_in_vmcall()) {
-		for (size_t i = 0; i < this->m_states.size(); i++) {
-			this->m_states[i].initialize(i, max);
-		}
-	} else {
+	if (max > MAX_VARIANT_SLOTS) {
+		ERR_PRINT("Sandbox: Maximum references cannot exceed " + itos(MAX_VARIANT_SLOTS));
+		max = MAX_VARIANT_SLOTS;
+	}
+	if (this->is_in_vmcall()) {
 		ERR_PRINT("Sandbox: Cannot change max references during a Sandbox call.");
+		return;
+	}
+	// Permanent Variants are referenced by address, so their storage must not be reallocated
+	const CurrentState &perm_state = this->m_states[0];
+	if (!perm_state.scoped_variants.empty() && max > perm_state.variants.capacity()) {
+		ERR_PRINT("Sandbox: Cannot raise max references while permanent Variants exist. Set it before loading the program.");
+		return;
+	}
+	this->m_max_refs = max;
+	for (size_t i = 0; i < this->m_states.size(); i++) {
+		this->m_states[i].initialize(i, max);
+	}
+}
+
+void Sandbox::set_max_call_depth(uint32_t max) {
+	if (max < 1 || max > MAX_LEVEL_LIMIT) {
+		ERR_PRINT("Sandbox: Maximum call depth must be between 1 and " + itos(MAX_LEVEL_LIMIT));
+		return;
+	}
+	if (max < this->m_level) {
+		ERR_PRINT("Sandbox: Cannot lower the maximum call depth below the current call depth.");
+		return;
+	}
+	this->m_max_level = max;
+	// Release levels that can no longer be reached, keeping the ones in use
+	if (this->m_states.size() > max + 1) {
+		this->m_states.resize(max + 1);
 	}
 }
 
@@ -1612,7 +2274,13 @@ int64_t Sandbox::get_heap_deallocation_counter() const {
 }
 
 void Sandbox::print(const Variant &v) {
-	static bool already_been_here = false;
+	if (UNLIKELY(is_worker_thread()) && this->m_redirect_stdout.is_valid()) {
+		// The callback is user script, which may only run on the main thread
+		run_on_main_thread([this, &v] { this->print(v); });
+		return;
+	}
+	// Per thread, as sandboxes may print from worker threads at the same time
+	static thread_local bool already_been_here = false;
 	if (already_been_here) {
 		ERR_PRINT("Recursive call to Sandbox::print() detected, ignoring.");
 		return;
@@ -1,8 +1,13 @@
 #pragma once
 #include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
 #include <godot_cpp/classes/node.hpp>
 #include <godot_cpp/core/binder_common.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
 #include <libriscv/machine.hpp>
+#include <memory>
 #include <optional>
 
 using namespace godot;
@@ -10,8 +15,11 @@ using namespace godot;
 using gaddr_t = riscv::address_type<RISCV_ARCH>;
 using machine_t = riscv::Machine<RISCV_ARCH>;
 #include "elf/script_elf.h"
+#include "scoped_object_set.h"
+#include "shared_memory_allocator.h"
 #include "vmcallable.h"
 #include "vmproperty.h"
+class SandboxCallSite;
 
 /**
  * @brief The Sandbox class is a Godot node that provides a safe environment for running untrusted code.
@@ -40,23 +48,62 @@ public:
 	static constexpr unsigned MAX_HEAP = 20ul; // MBs
 	static constexpr unsigned MAX_VMEM = 20ul; // MBs
 	static constexpr unsigned MAX_HEAP_ALLOCS = 4000; // Max guest heap allocations
-	static constexpr unsigned MAX_LEVEL = 4; // Maximum call recursion depth
+	static constexpr unsigned MAX_LEVEL = 8; // Default maximum call recursion depth
+	static constexpr unsigned MAX_LEVEL_LIMIT = 64; // Upper limit for the configurable call recursion depth
 	static constexpr unsigned MAX_REFS = 100; // Default maximum number of references
 	static constexpr unsigned EDITOR_THROTTLE = 8; // Throttle VM calls from the editor
 	static constexpr unsigned MAX_PROPERTIES = 32; // Maximum number of sandboxed properties
 	static constexpr unsigned MAX_PUBLIC_FUNCTIONS = 128; // Maximum number of public functions
+	static constexpr unsigned MAX_DEFERRED_WRITES = 1u << 20; // Maximum number of recorded writes between flushes
+	static constexpr unsigned MAX_INTERNED_NAMES = 16384; // Maximum number of interned names
+	static constexpr unsigned MAX_ARRAY_VIEWS = 1024; // Maximum number of packed array views in progress
+	static constexpr unsigned MAX_CHANNEL_CAPACITY = 64u << 20; // Maximum size of a channel ring buffer
 	static constexpr gaddr_t SHM_BASE_ADDRESS = 0x400000000; // 16 GB
+	// Variant handles passed to the guest: [permanent:1][generation:15][slot:16]
+	static constexpr uint32_t VARIANT_HANDLE_PERMANENT = 0x80000000;
+	static constexpr uint32_t VARIANT_HANDLE_SLOT_MASK = 0xFFFF;
+	static constexpr uint32_t VARIANT_HANDLE_GENERATION_MASK = 0x7FFF;
+	static constexpr unsigned MAX_VARIANT_SLOTS = VARIANT_HANDLE_SLOT_MASK + 1;
 
 	struct CurrentState {
+		// Variants owned by this state. Capacity is reserved up front and never exceeded,
+		// so elements keep their addresses, and can be found from a pointer in O(1).
 		std::vector<Variant> variants;
+		// Slots addressed by Variant handles, pointing into variants or to Variants owned by the caller
 		std::vector<const Variant *> scoped_variants;
-		std::vector<uintptr_t> scoped_objects;
+		ScopedObjectSet scoped_objects;
+		// Permanent state only: the generation of each slot, and the slots that have been freed
+		std::vector<uint16_t> generations;
+		std::vector<uint32_t> free_slots;
+		// The generation of temporary handles, advanced by each call
+		uint16_t generation = 1;
+		// The keys and values of the Dictionary last copied in chunks by the guest, so that each
+		// chunk does not copy all of them again. Matched by Variant and size, and cleared by writes.
+		struct DictionaryRange {
+			const Variant *dictionary = nullptr;
+			int64_t size = 0;
+			Array keys;
+			Array values;
+		} dictionary_range;
 
 		void append(Variant &&value);
+		/// @brief Store a Variant in a permanent slot, reusing a freed slot if possible.
+		/// @return The slot index, or -1 if there is no room.
+		int32_t append_permanent(Variant &&value);
+		/// @brief Reference a Variant from a permanent slot, reusing a freed slot if possible.
+		/// @return The slot index, or -1 if there is no room.
+		int32_t insert_permanent(const Variant *value);
+		/// @brief Free a permanent slot, invalidating all handles to it.
+		void release_permanent(uint32_t slot);
 		void initialize(unsigned level, unsigned max_refs);
 		void reinitialize(unsigned level, unsigned max_refs);
 		void reset();
 		bool is_mutable_variant(const Variant &var) const;
+		/// @brief Get the Variant owned by this state at the given address, if any.
+		Variant *find_owned_variant(const Variant *var) {
+			const bool owned = var >= variants.data() && var < variants.data() + variants.size();
+			return owned ? const_cast<Variant *>(var) : nullptr;
+		}
 	};
 	struct LookupEntry {
 		String name;
@@ -86,6 +133,7 @@ public:
 
 	static Sandbox *FromBuffer(const PackedByteArray &buffer) { return memnew(Sandbox(buffer)); }
 	static Sandbox *FromProgram(Ref<ELFScript> program) { return memnew(Sandbox(std::move(program))); }
+	static Sandbox *FromTemplate(Ref<ELFScript> program);
 
 	// -= VM function calls =-
 
@@ -125,6 +173,56 @@ public:
 	Variant vmcallable(String function, Array args);
 	Variant vmcallable_address(uint64_t address, Array args);
 
+	/// @brief Call a function in the guest once for each array of arguments, entering the VM only once.
+	/// @param function The name of the function to call.
+	/// @param argument_arrays An array of argument arrays, one for each call.
+	/// @return An array with the return value of each call, or an empty array if an argument array is invalid.
+	/// @note If a call throws an exception, the remaining calls are skipped, and the array ends before the call that threw.
+	/// Invalid argument arrays are reported before any call is made, and are not counted as guest exceptions.
+	Array vmcall_batch(const String &function, const Array &argument_arrays);
+	/// @brief Call a function in the guest once for each group of float arguments, entering the VM only once.
+	/// @param function The name of the function to call.
+	/// @param arguments The arguments of all calls, grouped by call.
+	/// @param arguments_per_call The number of arguments passed to each call, which may be 0.
+	/// @param call_count The number of calls, which is required when there are no arguments per call.
+	/// By default it is the number of arguments divided by the arguments per call.
+	/// @return An array with the return value of each call, converted to float.
+	/// @note If a call throws an exception, the remaining calls are skipped, and the array ends before the call that threw.
+	PackedFloat64Array vmcall_batch_packed(const String &function, const PackedFloat64Array &arguments, int arguments_per_call = 1, int64_t call_count = -1);
+
+	/// @brief Call a function in each of the given sandboxes in parallel, on the WorkerThreadPool.
+	/// Each sandbox runs on a single worker thread for the duration of its call. System calls that
+	/// access the scene tree are queued to the main thread, which waits for the calls to complete.
+	/// @param sandboxes The sandboxes to call the function in. Each sandbox may appear only once.
+	/// @param function The name of the function to call.
+	/// @param args The arguments passed to every call.
+	/// @return An array with the return value of each call, in the order of the sandboxes.
+	/// @note Sandboxes that share pages with a running sandbox (eg. forks of it) must not be called at the same time.
+	static Array vmcall_parallel(const Array &sandboxes, const String &function, const Array &args);
+
+	/// @brief Check if the current thread is running a sandbox call on behalf of vmcall_parallel().
+	/// @return True if the current thread is a worker thread, false otherwise.
+	static bool is_worker_thread() noexcept { return t_worker_thread; }
+
+	/// @brief Run a system call handler on the main thread, blocking the calling worker thread until it completes.
+	/// Used for system calls that access the scene tree, which is not thread-safe.
+	/// @param machine The machine of the sandbox making the system call.
+	/// @param handler The system call handler.
+	static void run_on_main_thread(machine_t &machine, void (*handler)(machine_t &));
+	/// @brief Run a function on the main thread, blocking the calling worker thread until it completes.
+	/// Used for calling into user scripts, eg. Callables, which may only run on the main thread.
+	static void run_on_main_thread(std::function<void()> &&function);
+
+	/// @brief Create a pre-bound call site for a function in the guest with a declared type signature.
+	/// The address and the argument layout are resolved once, so that repeated calls
+	/// do no name hashing, no address lookups and no generic argument conversions.
+	/// @param function The name of the function to call.
+	/// @param argument_types The Variant types of the arguments. NIL means any Variant.
+	/// @param return_type The Variant type of the return value.
+	/// @return The call site, or null if the function was not found.
+	/// @note The call site must be re-created if a new program is loaded.
+	Ref<SandboxCallSite> create_call_site(const String &function, const PackedInt32Array &argument_types, int return_type = Variant::NIL);
+
 	/// @brief Set whether to prefer register values for VM function calls.
 	/// @param use_unboxed_arguments True to prefer register values, false to prefer Variant values.
 	void set_unboxed_arguments(bool use_unboxed_arguments) { m_use_unboxed_arguments = use_unboxed_arguments; }
@@ -140,6 +238,66 @@ public:
 	/// @return True if precise simulation is used, false otherwise.
 	bool get_precise_simulation() const { return m_precise_simulation; }
 
+	// -= Deferred Writes =-
+
+	/// @brief Set whether scene tree writes made by the guest are recorded instead of applied.
+	/// Recorded writes are applied in order by flush_deferred_writes(), on the main thread.
+	/// While recording, reads see the scene as of the last flush, not the pending writes.
+	/// @param deferred_writes True to record writes, false to apply them immediately.
+	void set_deferred_writes(bool deferred_writes) { m_deferred_writes = deferred_writes; }
+	bool get_deferred_writes() const { return m_deferred_writes; }
+	/// @brief Get the number of recorded writes waiting to be applied.
+	int64_t get_deferred_write_count() const { return m_deferred_commands.size(); }
+	/// @brief Apply all recorded writes in one batch. Must be called on the main thread.
+	/// Writes to objects that have been freed since they were recorded are skipped,
+	/// as are writes that are no longer allowed by the restrictions of the sandbox.
+	/// @return The number of writes that were applied.
+	int64_t flush_deferred_writes();
+	/// @brief The restriction that a deferred write must pass when it is applied.
+	enum class DeferredCheck : uint8_t {
+		NONE, // The write is not restricted.
+		METHOD, // The method must be allowed on the object.
+		PROPERTY, // The write is a call to set(), and the property in the first argument must be settable.
+	};
+	/// @brief Record a write to an object, by calling a method on it, to be applied at the next flush.
+	/// Restrictions may call back into scripts, so they are checked on the main thread during the flush.
+	/// @param object The object to write to.
+	/// @param check The restriction that the write must pass.
+	/// @param method The method that performs the write.
+	/// @param argc The number of arguments.
+	/// @param arg0 The first argument, if any.
+	/// @param arg1 The second argument, if any.
+	void record_deferred_write(godot::Object *object, DeferredCheck check, const StringName &method, uint8_t argc = 0, Variant &&arg0 = Variant(), Variant &&arg1 = Variant());
+
+	// -= Method Handles =-
+
+	/// @brief Resolve a method of an object's class into a handle, which the guest
+	/// can reuse for later calls without passing and interning the method name again.
+	/// The class and method names are interned, and the handle holds both of their handles.
+	/// @param obj The object whose class has the method.
+	/// @param method The name of the method.
+	/// @return The handle, never 0. The same class and method always give the same handle.
+	uint32_t resolve_method_handle(godot::Object *obj, const String &method);
+	/// @brief Get the method name behind a handle, for a call on an object.
+	/// @param obj The object to call the method on, which must be of the class the handle was resolved for.
+	/// @param handle A handle from resolve_method_handle().
+	/// @return The method name.
+	const StringName &get_method_handle(godot::Object *obj, uint32_t handle) const;
+
+	// -= Interned Names =-
+
+	/// @brief Intern a method or property name, so that the guest can pass a small handle
+	/// to call and property system calls, instead of a string that must be interned every time.
+	/// @param name The name to intern.
+	/// @return The handle, starting at 1. The same name always gives the same handle.
+	uint32_t intern_name(const StringName &name);
+	/// @brief Get the name behind a handle.
+	/// @param handle A handle from intern_name().
+	/// @return The interned name.
+	const StringName &get_interned_name(uint32_t handle) const;
+	/// @brief Get the number of interned names.
+	int64_t get_interned_name_count() const { return m_interned_names.size(); }
+
 	/// @brief Set whether or not to enable profiling of the guest program.
 	/// @param enable True to enable profiling, false to disable it.
 	void set_profiling(bool enable);
@@ -157,7 +315,16 @@ public:
 	// -= Sandbox Properties =-
 
 	uint32_t get_max_refs() const { return m_max_refs; }
+	/// @brief Set the maximum number of objects and Variants referenced by a sandbox call.
+	/// Once the program has created permanent Variants, the maximum can no longer be raised.
+	/// @param max The maximum number of references.
 	void set_max_refs(uint32_t max);
+	/// @brief Set the maximum number of nested VM calls, eg. guest -> host -> guest callbacks.
+	/// @param max The maximum call depth, between 1 and MAX_LEVEL_LIMIT.
+	void set_max_call_depth(uint32_t max);
+	uint32_t get_max_call_depth() const { return m_max_level; }
+	/// @brief Get the number of VM calls currently in progress.
+	uint32_t get_call_depth() const { return m_level; }
 	void set_memory_max(uint32_t max);
 	uint32_t get_memory_max() const { return m_memory_max; }
 	void set_instructions_max(int64_t max) { m_insn_max = max; }
@@ -203,7 +370,23 @@ public:
 	/// @brief Add a hash to address mapping to the cache.
 	/// @param name The name of the function or symbol.
 	/// @param address The address of the function or symbol.
-	void add_cached_address(const String &name, gaddr_t address) const;
+	/// @param unboxed_return The type the function returns directly in registers, or VARIANT_MAX if it returns a Variant.
+	void add_cached_address(const String &name, gaddr_t address, Variant::Type unboxed_return = Variant::VARIANT_MAX) const;
+
+	/// @brief Check if a type can be returned directly in registers by a public API function.
+	/// @param type The Variant type to check.
+	/// @return True if the type can be returned unboxed, false otherwise.
+	static bool is_unboxed_return_type(Variant::Type type);
+
+	/// @brief Get the type a guest function returns directly in registers.
+	/// @param address The address of the function.
+	/// @return The unboxed return type, or VARIANT_MAX if the function returns a Variant.
+	Variant::Type unboxed_return_type_of(gaddr_t address) const {
+		if (m_unboxed_returns.empty())
+			return Variant::VARIANT_MAX;
+		auto it = m_unboxed_returns.find(address);
+		return (it != m_unboxed_returns.end()) ? it->second : Variant::VARIANT_MAX;
+	}
 
 	// -= Call State Management =-
 
@@ -252,6 +435,24 @@ public:
 	/// @return True if the variant is permanent, false otherwise.
 	static bool is_permanent_variant(int32_t idx) noexcept { return idx < 0 && idx != INT32_MIN; }
 
+	/// @brief Get the number of Variants and objects that the guest can still reference in the current call.
+	/// @return The smaller of the free Variant slots and the free object references.
+	unsigned get_free_references() const noexcept;
+
+	/// @brief Free a permanent variant, so that its slot can be reused.
+	/// Handles to the freed variant become invalid, and are rejected if used again.
+	/// @param idx The index of the permanent variant to free.
+	void free_permanent_variant(int32_t idx);
+
+	/// @brief Create a Variant handle for the guest from a slot and its generation.
+	static unsigned make_variant_handle(bool permanent, uint32_t slot, uint16_t generation) noexcept {
+		return (permanent ? VARIANT_HANDLE_PERMANENT : 0u) | (uint32_t(generation) << 16) | slot;
+	}
+	/// @brief Advance a handle generation, skipping zero so that no valid handle equals INT32_MIN.
+	static uint16_t next_variant_generation(uint16_t generation) noexcept {
+		return (generation >= VARIANT_HANDLE_GENERATION_MASK) ? 1 : generation + 1;
+	}
+
 	/// @brief Assign a permanent variant index with a new variant.
 	/// @param idx The index of the permanent variant to assign.
 	/// @param var The new variant to move-assign.
@@ -272,12 +473,12 @@ public:
 
 	/// @brief Remove a scoped object from the current state.
 	/// @param ptr The pointer to the object to remove.
-	void rem_scoped_object(const void *ptr) { state().scoped_objects.erase(std::remove(state().scoped_objects.begin(), state().scoped_objects.end(), reinterpret_cast<uintptr_t>(ptr)), state().scoped_objects.end()); }
+	void rem_scoped_object(const void *ptr) { state().scoped_objects.erase(reinterpret_cast<uintptr_t>(ptr)); }
 
 	/// @brief Check if an object is scoped in the current state.
 	/// @param ptr The pointer to the object to check.
 	/// @return True if the object is scoped, false otherwise.
-	bool is_scoped_object(const void *ptr) const noexcept { return state().scoped_objects.end() != std::find(state().scoped_objects.begin(), state().scoped_objects.end(), reinterpret_cast<uintptr_t>(ptr)); }
+	bool is_scoped_object(const void *ptr) const noexcept { return state().scoped_objects.contains(reinterpret_cast<uintptr_t>(ptr)); }
 
 	// -= Sandbox Restrictions =-
 
@@ -415,6 +616,42 @@ public:
 	/// @brief Reset the sandbox, clearing all state and reloads the program.
 	void reset(bool unload = false);
 
+	/// @brief Fork a fully initialized sandbox, sharing its post-main() memory copy-on-write.
+	/// Only the CPU registers, the permanent Variants and the function lookup cache are copied,
+	/// so the program does not have to be loaded and run through main() again.
+	/// @param initialized The sandbox to fork from. It must have a program loaded and not be in a VM call.
+	/// @return True if the fork succeeded, false otherwise.
+	/// @note The forked-from sandbox must outlive the fork. If it is reset or destroyed, its forks are unloaded.
+	/// @note The forked-from sandbox becomes a frozen template: VM calls into it are refused while it has forks,
+	/// as its pages are shared with them. Sandboxes holding permanent object references cannot be forked.
+	bool fork_from(Sandbox *initialized);
+
+	/// @brief Fork the shared, initialized template instance of a program.
+	/// @param program The program whose template instance to fork from.
+	/// @return True if the fork succeeded, false otherwise.
+	bool fork_from_template(Ref<ELFScript> program);
+
+	/// @brief Save a snapshot of the initialized program: dirty pages, registers, the native heap arena,
+	/// properties, permanent Variants and the public function table. When a program has a matching
+	/// snapshot, loading it restores the snapshot instead of running main().
+	/// Snapshots are never created automatically: a snapshot saved to snapshot_path_for() the ELF
+	/// is loaded together with the program, and ELFScript.load_snapshot() loads one from any path.
+	/// @param path The path to the snapshot file.
+	/// @return OK on success, otherwise an error code.
+	Error save_snapshot(const String &path) const;
+
+	/// @brief Read a snapshot file, if it was saved from the given program.
+	/// @param path The path to the snapshot file.
+	/// @param elf The program the snapshot must match.
+	/// @param snapshot The snapshot to fill in.
+	/// @return True if the snapshot was read, false if it does not exist or does not match.
+	static bool load_snapshot(const String &path, const PackedByteArray &elf, ELFSnapshot &snapshot);
+
+	/// @brief Get the path of the snapshot file belonging to an ELF program.
+	/// @param elf_path The path to the ELF program.
+	/// @return The path to the snapshot file.
+	static String snapshot_path_for(const String &elf_path);
+
 	struct BinaryInfo {
 		String language;
 		PackedStringArray functions;
@@ -435,6 +672,9 @@ public:
 
 	/// @brief Share a byte array with the guest program. Page-unaligned memory
 	/// at the end is initialized to zero.
+	/// If the size of the array in bytes is not a multiple of the page size, the partial page at the end
+	/// is a copy: guest writes to it reach the array in unshare_array(), and host writes are not seen by
+	/// the guest. Resize the array to page_padded_size() first to share all of it without copying.
 	/// @param allow_write Whether the guest program is allowed to write to the shared memory range.
 	/// @param array The array to share.
 	/// @return The guest address of the shared memory range.
@@ -449,12 +689,46 @@ public:
 	gaddr_t share_vec3_array(bool allow_write, const PackedVector3Array &array);
 	gaddr_t share_vec4_array(bool allow_write, const PackedVector4Array &array);
 
+	/// @brief Get the smallest number of elements, at least the given number, that fills whole pages.
+	/// Arrays of this size are shared entirely without copying, including the end of the array.
+	/// @param element_count The number of elements in use.
+	/// @param element_size The size of an element in bytes, eg. 4 for PackedFloat32Array.
+	/// @return The padded number of elements.
+	static int64_t page_padded_size(int64_t element_count, int64_t element_size);
+
 	/// @brief Unshare an array of any type from the guest program.
 	/// @param address The guest address of the shared memory range.
 	/// @return True if the array was successfully unshared, false otherwise.
 	/// @note This will not free the memory, but will remove the shared memory range from the sandbox.
 	bool unshare_array(gaddr_t address);
 
+	/// @brief Open a channel, a ring buffer in memory shared by the host and the guest, which
+	/// stays mapped until it is closed. Messages are passed without making VM calls, with one
+	/// producer and one consumer, which may run on different threads.
+	/// @param capacity The size of the ring buffer in bytes, rounded up to a power of two.
+	/// @return The guest address of the channel, or 0 on failure.
+	gaddr_t open_channel(int64_t capacity);
+	/// @brief Close a channel, unmapping it from the guest.
+	/// @param address The guest address of the channel.
+	/// @return True if the channel was closed, false otherwise.
+	bool close_channel(gaddr_t address);
+	/// @brief Send a message through a channel, with the host as the producer.
+	/// @param address The guest address of the channel.
+	/// @param message The message to send.
+	/// @return True if the message was sent, false if the channel is full.
+	bool channel_send(gaddr_t address, const PackedByteArray &message);
+	/// @brief Receive the next message from a channel, with the host as the consumer.
+	/// @param address The guest address of the channel.
+	/// @return The message, or null if the channel is empty.
+	Variant channel_receive(gaddr_t address);
+
+	/// @brief Map the data of a packed array read-only into the guest, until the current VM call returns.
+	/// @param array The packed array, which is kept alive and unchanged while the view exists.
+	/// @param data The data of the packed array.
+	/// @param bytes The size of the data in bytes.
+	/// @return The guest address of the view, or 0 on failure.
+	gaddr_t view_array_internal(Variant &&array, const void *data, size_t bytes);
+
 	// -= Profiling & Hotspots =-
 
 	/// @brief Generate the top N hotspots from profiling recorded so far.
@@ -508,10 +782,13 @@ public:
 	/// @brief Binary translate the program and produce embeddable code
 	/// @param ignore_instruction_limit If true, ignore the instruction limit. Infinite loops are possible.
 	/// @param automatic_nbit_as If true, use and-masking on all memory accesses based on the rounded-down Po2 arena size.
+	/// @param options Additional options:
+	/// - instruction_budget: The maximum number of instructions to translate, 75000 by default, or 0 for no limit.
+	/// - register_caching: If true, cache guest registers in the translated code. False by default.
 	/// @return The binary translation code.
 	/// @note This is only available if the RISCV_BINARY_TRANSLATION flag is set.
 	/// @warning Do *NOT* enable automatic_nbit_as unless you are sure the program is compatible with it.
-	String emit_binary_translation(bool ignore_instruction_limit = false, bool automatic_nbit_as = false) const;
+	String emit_binary_translation(bool ignore_instruction_limit = false, bool automatic_nbit_as = false, const Dictionary &options = Dictionary()) const;
 
 	/// @brief Open a shared library, which should self-register its functions.
 	/// @param shared_library_path The path to the shared library.
@@ -523,8 +800,19 @@ public:
 	/// @brief Try to emit the binary translation code, and then compile it. Does not load the binary translation.
 	/// @note For security reasons, the binary translation is not loaded automatically. A game restart is required,
 	/// as binary translations can only be loaded before any Sandbox instances are created.
+	/// @param options Additional options, the same as for emit_binary_translation().
 	/// @return True if the binary translation was emitted and compiled successfully, false otherwise.
-	bool try_compile_binary_translation(String shared_library_path = "res://bintr", const String &cc = "cc", const String &extra_cflags = "", bool ignore_instruction_limit = false, bool automatic_nbit_as = false);
+	bool try_compile_binary_translation(String shared_library_path = "res://bintr", const String &cc = "cc", const String &extra_cflags = "", bool ignore_instruction_limit = false, bool automatic_nbit_as = false, const Dictionary &options = Dictionary());
+
+	/// @brief Emit the binary translations of all the ELF programs in the project, and compile them
+	/// in parallel on the WorkerThreadPool into one shared library, which registers all of them when loaded.
+	/// @param shared_library_path The path of the shared library, without the extension.
+	/// @param options Additional options, the same as for emit_binary_translation().
+	/// @param programs The paths of the ELF programs to translate, or empty for all the programs in the project.
+	/// @note The translations match sandboxes with the default memory limit, like try_compile_binary_translation()
+	/// matches the sandbox it is called on. Load the library with load_binary_translation() at startup.
+	/// @return True if the shared library was compiled successfully, false otherwise.
+	static bool try_compile_binary_translation_bundle(String shared_library_path = "res://bintr", const String &cc = "cc", const String &extra_cflags = "", bool ignore_instruction_limit = false, bool automatic_nbit_as = false, const Dictionary &options = Dictionary(), PackedStringArray programs = PackedStringArray());
 
 	/// @brief  Check if the program has found and loaded binary translation.
 	/// @return True if binary translation is loaded, false otherwise.
@@ -565,6 +853,32 @@ public:
 		return this->m_bintr_bg_compilation;
 	}
 
+	/// @brief Set the priority of the background compilation of this sandbox's program.
+	/// Compilations with a higher priority run first, eg. for sandboxes that are visible or called often.
+	/// @param priority The priority, 0 by default.
+	void set_binary_translation_priority(int priority);
+	int get_binary_translation_priority() const {
+		return this->m_bintr_priority;
+	}
+
+	/// @brief Set the number of VM calls into this sandbox before its program is JIT-compiled.
+	/// Until then the program is interpreted, which makes loading large programs fast, and
+	/// only programs that are actually called often pay for the compilation.
+	/// @param threshold The number of VM calls, or 0 to compile when the program is loaded.
+	/// @note Only applies to programs loaded after it is set, with background compilation enabled.
+	void set_binary_translation_tier_threshold(int64_t threshold) {
+		this->m_bintr_tier_threshold = std::max(int64_t(0), threshold);
+	}
+	int64_t get_binary_translation_tier_threshold() const {
+		return this->m_bintr_tier_threshold;
+	}
+
+	/// @brief Get the JIT cache entry of a program, which keeps a system-compiled translation under user://.
+	/// The entry depends on the program, the extension build and the translation settings of this sandbox.
+	/// @param binary The program.
+	/// @return The path of the entry, or an empty string if the platform has no JIT cache.
+	String get_jit_cache_path(const PackedByteArray &binary) const;
+
 	/// @brief Enable or disable the use of JIT-compilation.
 	/// @param enable If true, enable JIT-compilation, false to disable it.
 	static void set_jit_enabled(bool enable) { m_bintr_jit = enable; }
@@ -579,6 +893,11 @@ public:
 	bool get_binary_translation_register_caching() const { return false; }
 	void set_binary_translation_bg_compilation(bool) {}
 	bool get_binary_translation_bg_compilation() const { return false; }
+	void set_binary_translation_priority(int) {}
+	int get_binary_translation_priority() const { return 0; }
+	void set_binary_translation_tier_threshold(int64_t) {}
+	int64_t get_binary_translation_tier_threshold() const { return 0; }
+	String get_jit_cache_path(const PackedByteArray &) const { return String(); }
 	static void set_jit_enabled(bool) {}
 	static bool is_jit_enabled() { return false; }
 #endif
@@ -587,8 +906,19 @@ public:
 		return riscv::libtcc_enabled;
 	}
 
+	/// @brief Get the background compilations shared by all sandboxes.
+	/// @return A dictionary with the number of "queued" jobs, "deferred" jobs waiting to be
+	/// promoted by tiering, and the maximum number of "workers".
+	static Dictionary get_background_compilations();
+
+	/// @brief Get the generation of the loaded program, which changes whenever the machine is reset,
+	/// eg. when a program is loaded or reloaded. Guest addresses are only valid within one generation.
+	/// @return The program generation.
+	uint64_t get_program_generation() const noexcept { return m_program_generation; }
+
 	void assault(const String &test, int64_t iterations);
-	Variant vmcall_internal(gaddr_t address, const Variant **args, int argc);
+	static PackedStringArray test_compile_scheduler();
+	Variant vmcall_internal(gaddr_t address, const Variant **args, int argc, const SandboxCallSite *call_site = nullptr);
 	machine_t &machine() { return *m_machine; }
 	const machine_t &machine() const { return *m_machine; }
 	void print(const Variant &v);
@@ -617,12 +947,31 @@ public:
 private:
 	static void generate_runtime_cpp_api(bool use_argument_names = false);
 	gaddr_t share_array_internal(void *data, size_t size, bool allow_write);
-	bool is_in_vmcall() const noexcept { return m_current_state != &m_states[0]; }
+	gaddr_t map_shared_memory(void *data, size_t bytes, bool allow_write);
+	void unmap_shared_memory(gaddr_t address, size_t bytes);
+	void release_array_views(uint32_t level);
+	bool is_in_vmcall() const noexcept { return m_level != 0; }
+#ifdef RISCV_BINARY_TRANSLATION
+	static String emit_translation_code(std::string_view binary, riscv::MachineOptions<RISCV_ARCH> options);
+#endif
+	static bool compile_translation(const String &code, const String &c99_path, const String &library_path, const String &cc, const String &extra_cflags, bool verbose, const PackedStringArray &objects = PackedStringArray());
+#if defined(RISCV_BINARY_TRANSLATION) && defined(RISCV_LIBTCC)
+	// The JIT cache keeps system-compiled translations of programs under user://, to be loaded by later runs
+	bool load_jit_cache(const String &cache_path);
+	void update_jit_cache(const String &cache_path, const PackedByteArray &binary);
+	// Promotes the deferred compilation of the program once enough VM calls have been made
+	void count_tiered_calls(int64_t calls);
+#endif
+	CurrentState *push_state();
+	void pop_state();
 	void constructor_initialize();
 	void full_reset();
 	void reset_machine();
+	void detach_forks();
+	void cache_public_api_functions(const Array &functions);
 	void set_program_data_internal(Ref<ELFScript> program);
 	bool load(const PackedByteArray *vbuf, const std::vector<std::string> *argv = nullptr);
+	bool restore_snapshot();
 	static PackedStringArray get_public_functions(const machine_t &);
 	void read_program_properties(bool editor) const;
 	void handle_exception(gaddr_t);
@@ -632,11 +981,22 @@ private:
 	static void initialize_syscalls();
 	static void initialize_syscalls_2d();
 	static void initialize_syscalls_3d();
-	GuestVariant *setup_arguments(gaddr_t &sp, const Variant **args, int argc);
-	void setup_arguments_native(gaddr_t arrayDataPtr, GuestVariant *v, const Variant **args, int argc);
+	GuestVariant *setup_arguments(gaddr_t &sp, const Variant **args, int argc, bool sret = true);
+	void execute_guest(gaddr_t address);
+	/// @return The number of calls that completed, which is less than count if a call threw.
+	template <typename ArgumentsFn, typename ResultFn>
+	int64_t vmcall_batch_internal(gaddr_t address, int64_t count, ArgumentsFn &&arguments_for, ResultFn &&result_for);
+	static void parallel_call_task(uint32_t index);
+	static void process_main_thread_calls();
+	void setup_arguments_native(gaddr_t arrayDataPtr, GuestVariant *v, const Variant **args, int argc, bool sret = true);
+	Variant unboxed_return_value(Variant::Type type) const;
 
 	machine_t *m_machine = nullptr;
 	godot::Node *m_tree_base = nullptr;
+	// The sandbox this machine was forked from, which owns the pages we share copy-on-write.
+	Sandbox *m_fork_parent = nullptr;
+	// Sandboxes that were forked from this one, and must be unloaded before our machine goes away.
+	std::vector<Sandbox *> m_forks;
 	uint32_t m_max_refs = MAX_REFS;
 	uint32_t m_memory_max = MAX_VMEM;
 	int64_t m_insn_max = MAX_INSTRUCTIONS;
@@ -647,25 +1007,71 @@ private:
 	bool m_resumable_mode = false; // If enabled, allow running startup in small increments
 	bool m_precise_simulation = false; // Run simulation in the slower, precise mode
 	bool m_is_initialization = false; // If true, the program is in the initialization phase
+	bool m_deferred_writes = false; // Record scene tree writes instead of applying them
 #ifdef RISCV_LIBTCC
 	bool m_bintr_automatic_nbit_as = false; // Automatic n-bit address space for binary translation
 	bool m_bintr_register_caching = true; // Use register caching for binary translation
 	bool m_bintr_bg_compilation = true; // Perform binary translation in the background
+	int m_bintr_priority = 0; // Priority of background compilation
+	int64_t m_bintr_tier_threshold = 0; // VM calls before the program is JIT-compiled
+	int64_t m_bintr_tier_calls = 0; // VM calls made while the compilation is deferred
+	uint64_t m_bintr_tier_key = 0; // Key of the deferred compilation, or 0 if there is none
+	uint64_t m_bintr_key = 0; // Key of the background compilation of the program, or 0 if there is none
 #endif
 
 	CurrentState *m_current_state = nullptr;
 	// State stack, with the permanent (initial) state at index 0.
 	// That means eg. static Variant values are held stored in the state at index 0,
 	// so that they can be accessed by future VM calls, and not lost when a call ends.
-	std::array<CurrentState, MAX_LEVEL> m_states;
+	// Levels are created on demand and kept, along with their capacity, for future calls.
+	// A deque is used so that growing the stack does not move the existing states.
+	std::deque<CurrentState> m_states;
+	uint32_t m_level = 0; // Index of the current state, which is the number of calls in progress
+	uint32_t m_max_level = MAX_LEVEL;
+
+	// Scene tree writes recorded while deferred writes are enabled
+	struct DeferredCommand {
+		uint64_t object_id;
+		StringName method;
+		DeferredCheck check;
+		uint8_t argc;
+		Variant args[2];
+	};
+	std::vector<DeferredCommand> m_deferred_commands;
+
+	// Names interned by the guest, indexed by handle - 1, including the class
+	// and method names of method handles
+	std::vector<StringName> m_interned_names;
+	HashMap<StringName, uint32_t> m_interned_name_lookup;
 
 	// Properties
 	mutable std::vector<SandboxProperty> m_properties;
 	mutable std::unordered_map<int64_t, LookupEntry> m_lookup;
-
-	// Shared memory ranges
-	std::vector<SharedMemoryRange> m_shared_memory_ranges;
-	gaddr_t m_shared_memory_base = SHM_BASE_ADDRESS;
+	// Public functions that return their value in registers, instead of through a Variant pointer in A0.
+	mutable std::unordered_map<gaddr_t, Variant::Type> m_unboxed_returns;
+
+	// Shared memory ranges, by start address
+	std::map<gaddr_t, SharedMemoryRange> m_shared_memory_ranges;
+	// Guest addresses for shared arrays, array views and channels
+	SharedMemoryAllocator m_shared_memory_allocator{ SHM_BASE_ADDRESS };
+	// Packed arrays mapped into the guest for the duration of a VM call, innermost call last
+	struct ArrayView {
+		gaddr_t start;
+		gaddr_t size;
+		uint32_t level;
+		const void *data;
+		Variant array;
+	};
+	std::vector<ArrayView> m_array_views;
+	// Ring buffers shared with the guest until they are closed
+	struct Channel {
+		gaddr_t address;
+		gaddr_t size;
+		uint32_t capacity; // Never read back from the guest-writable memory
+		std::unique_ptr<uint64_t[]> memory;
+	};
+	std::vector<Channel> m_channels;
+	Channel *find_channel(gaddr_t address);
 
 	// Restrictions
 	std::unordered_set<godot::Object *> m_allowed_objects;
@@ -691,6 +1097,7 @@ private:
 	Ref<ELFScript> m_program_data;
 	PackedByteArray m_program_bytes;
 	int m_source_version = -1;
+	uint64_t m_program_generation = 0; // Incremented whenever the machine is reset
 
 	// Stats
 	unsigned m_timeouts = 0;
@@ -712,13 +1119,15 @@ private:
 	static inline std::mutex profiling_mutex;
 	static inline std::mutex generate_hotspots_mutex;
 
-	// Global statistics
-	static inline uint64_t m_global_timeouts = 0;
-	static inline uint64_t m_global_exceptions = 0;
-	static inline uint64_t m_global_calls_made = 0;
-	static inline uint32_t m_global_instances_current = 0; // Counts the number of current instances
-	static inline uint32_t m_global_instances_seen = 0; // Incremented for each instance created
-	static inline double m_accumulated_startup_time = 0.0;
+	// Global statistics, updated by sandboxes running on any thread
+	static inline std::atomic<uint64_t> m_global_timeouts = 0;
+	static inline std::atomic<uint64_t> m_global_exceptions = 0;
+	static inline std::atomic<uint64_t> m_global_calls_made = 0;
+	static inline std::atomic<uint32_t> m_global_instances_current = 0; // Counts the number of current instances
+	static inline std::atomic<uint32_t> m_global_instances_seen = 0; // Incremented for each instance created
+	static inline std::atomic<double> m_accumulated_startup_time = 0.0;
+	// Set while the current thread runs a sandbox call from vmcall_parallel()
+	static inline thread_local bool t_worker_thread = false;
 	static inline bool m_bintr_jit = riscv::libtcc_enabled; // JIT compilation enabled
 };
 
@@ -731,6 +1140,9 @@ inline void Sandbox::CurrentState::reset() {
 	variants.clear();
 	scoped_variants.clear();
 	scoped_objects.clear();
+	dictionary_range = DictionaryRange();
+	// Handles from previous calls are no longer valid
+	generation = next_variant_generation(generation);
 }
 
 inline bool Sandbox::is_allowed_object(godot::Object *obj) const {
@@ -1,10 +1,16 @@
 #include "sandbox.h"
 
+#include "compile_scheduler.h"
+#include "sandbox_project_settings.h"
 #include <godot_cpp/classes/dir_access.hpp>
 #include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/hashing_context.hpp>
 #include <godot_cpp/classes/os.hpp>
 #include <godot_cpp/classes/project_settings.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
+#include <mutex>
+#include <unordered_set>
 
 #if defined(__linux__)
 # include <dlfcn.h>
@@ -29,53 +35,83 @@ extern "C" int unlink(const char* path);
 #endif
 extern "C" void libriscv_register_translation8(...);
 
-String Sandbox::emit_binary_translation(bool ignore_instruction_limit, bool automatic_nbit_as) const {
+#ifdef RISCV_BINARY_TRANSLATION
+static constexpr int64_t DEFAULT_TRANSLATION_BUDGET = 75'000;
+
+// Apply the options dictionary of emit_binary_translation() on top of the machine options
+static bool apply_translation_options(const Dictionary &dict, riscv::MachineOptions<RISCV_ARCH> &options) {
+	const Array keys = dict.keys();
+	for (int i = 0; i < keys.size(); i++) {
+		const String key = keys[i];
+		if (key != "instruction_budget" && key != "register_caching") {
+			ERR_PRINT("Sandbox: Unknown binary translation option: " + key);
+			return false;
+		}
+	}
+	const int64_t budget = dict.get("instruction_budget", DEFAULT_TRANSLATION_BUDGET);
+	if (budget < 0 || budget > int64_t(UINT32_MAX)) {
+		ERR_PRINT("Sandbox: Binary translation instruction budget out of range: " + itos(budget));
+		return false;
+	}
+	options.translate_instr_max = budget > 0 ? uint32_t(budget) : UINT32_MAX;
+	options.translate_use_register_caching = dict.get("register_caching", false);
+	return true;
+}
+#endif
+
+String Sandbox::emit_binary_translation(bool ignore_instruction_limit, bool automatic_nbit_as, const Dictionary &translation_options) const {
 	const std::string_view &binary = machine().memory.binary();
 	if (binary.empty()) {
 		ERR_PRINT("Sandbox: No binary loaded.");
 		return String();
 	}
 #ifdef RISCV_BINARY_TRANSLATION
-	std::string code_output;
 	// 1. Re-create the same options
-	auto options = std::make_shared<riscv::MachineOptions<RISCV_ARCH>>(machine().options());
-	options->use_shared_execute_segments = false;
-	options->translate_enabled = false;
-	options->translate_enable_embedded = false;
-	options->translate_invoke_compiler = false;
-	options->translate_ignore_instruction_limit = ignore_instruction_limit;
-	options->translate_automatic_nbit_address_space = automatic_nbit_as;
-	options->translate_use_register_caching = false;
+	riscv::MachineOptions<RISCV_ARCH> options = machine().options();
+	options.translate_ignore_instruction_limit = ignore_instruction_limit;
+	options.translate_automatic_nbit_address_space = automatic_nbit_as;
+	if (!apply_translation_options(translation_options, options)) {
+		return String();
+	}
+
+	const String code = emit_translation_code(binary, std::move(options));
+	// 2. Verify that the translation was successful
+	if (code.is_empty()) {
+		ERR_PRINT("Sandbox: Binary translation failed.");
+	}
+	return code;
+#else
+	ERR_PRINT("Sandbox: Binary translation is not enabled.");
+	return String();
+#endif
+}
+
+#ifdef RISCV_BINARY_TRANSLATION
+String Sandbox::emit_translation_code(std::string_view binary, riscv::MachineOptions<RISCV_ARCH> options) {
+	std::string code_output;
+	options.use_shared_execute_segments = false;
+	options.translate_enabled = false;
+	options.translate_enable_embedded = false;
+	options.translate_invoke_compiler = false;
 	// Avoid any shenanigans with background compilation
-	options->translate_background_callback = nullptr;
-	// TODO: Make this configurable
-	options->translate_instr_max = 75'000u;
+	options.translate_background_callback = nullptr;
 
-	// 2. Enable binary translation output to a string
-	options->cross_compile.push_back(riscv::MachineTranslationEmbeddableCodeOptions{
+	// Enable binary translation output to a string
+	options.cross_compile.clear();
+	options.cross_compile.push_back(riscv::MachineTranslationEmbeddableCodeOptions{
 		.result_c99 = &code_output,
 	});
 
-	// 3. Emit the binary translation by constructing a new machine
-	machine_t m{ binary, *options };
+	// Emit the binary translation by constructing a new machine
+	machine_t m{ binary, options };
 
-	// 4. Wait for any potential background compilation to finish
+	// Wait for any potential background compilation to finish
 	if constexpr (riscv::libtcc_enabled) {
 		m.cpu.current_execute_segment().wait_for_compilation_complete();
 	}
-
-	// 4. Verify that the translation was successful
-	if (code_output.empty()) {
-		ERR_PRINT("Sandbox: Binary translation failed.");
-		return String();
-	}
-	// 5. Return the translated code
 	return String::utf8(code_output.c_str(), code_output.size());
-#else
-	ERR_PRINT("Sandbox: Binary translation is not enabled.");
-	return String();
-#endif
 }
+#endif
 
 bool Sandbox::load_binary_translation(const String &shared_library_path, bool allow_insecure) {
 	if (m_global_instances_seen > 0 && !allow_insecure) {
@@ -115,18 +151,8 @@ bool Sandbox::load_binary_translation(const String &shared_library_path, bool al
 	return false;
 }
 
-bool Sandbox::try_compile_binary_translation(String shared_library_path, const String &cc, const String &extra_cflags, bool ignore_instruction_limit, bool automatic_nbit_as) {
-	if (this->is_binary_translated() && !this->is_jit()) {
-		return true;
-	}
-	if (this->is_in_vmcall()) {
-		ERR_PRINT("Sandbox: Cannot produce binary translation while in a VM call. This is a security risk.");
-		return false;
-	}
-	if (this->get_restrictions()) {
-		ERR_PRINT("Sandbox: Cannot produce binary translation while restrictions are enabled.");
-		return false;
-	}
+// Validate the path of a shared library to compile, and add the extension of the platform
+static bool add_shared_library_extension(String &shared_library_path) {
 	if (shared_library_path.is_empty()) {
 		ERR_PRINT("Sandbox: No shared library path specified.");
 		return false;
@@ -156,69 +182,369 @@ bool Sandbox::try_compile_binary_translation(String shared_library_path, const S
 	WARN_PRINT_ONCE("Sandbox: Compiling binary translations has not been implemented on this platform.");
 	return false;
 #endif
-	const String code = this->emit_binary_translation(ignore_instruction_limit, automatic_nbit_as);
-	if (code.is_empty()) {
-		ERR_PRINT("Sandbox: Failed to emit binary translation.");
+	return true;
+}
+
+bool Sandbox::try_compile_binary_translation(String shared_library_path, const String &cc, const String &extra_cflags, bool ignore_instruction_limit, bool automatic_nbit_as, const Dictionary &options) {
+	if (this->is_binary_translated() && !this->is_jit()) {
+		return true;
+	}
+	if (this->is_in_vmcall()) {
+		ERR_PRINT("Sandbox: Cannot produce binary translation while in a VM call. This is a security risk.");
 		return false;
 	}
-	static const String c99_path = "user://temp_sandbox_generated.c";
-	Ref<FileAccess> fa = FileAccess::open(c99_path, FileAccess::ModeFlags::WRITE);
-	if (!fa->is_open()) {
-		ERR_PRINT("Sandbox: Failed to open file for writing: " + c99_path);
+	if (this->get_restrictions()) {
+		ERR_PRINT("Sandbox: Cannot produce binary translation while restrictions are enabled.");
 		return false;
 	}
-	fa->store_string(code);
-	fa->close();
-	// Compile the generated code
-	Array args;
+	if (!add_shared_library_extension(shared_library_path)) {
+		return false;
+	}
+	const String code = this->emit_binary_translation(ignore_instruction_limit, automatic_nbit_as, options);
+	if (code.is_empty()) {
+		ERR_PRINT("Sandbox: Failed to emit binary translation.");
+		return false;
+	}
+	const String library_path = shared_library_path.replace("res://", "");
+	return compile_translation(code, "user://temp_sandbox_generated.c", library_path, cc, extra_cflags, true);
+}
+
+// MSVC is used on Windows, unless the compiler is zig cc
+static bool uses_msvc(const String &cc) {
+#ifdef YEP_IS_WINDOWS
+	return !cc.ends_with("zig");
+#else
+	return false;
+#endif
+}
+
+// The flags for compiling generated code, into either shared libraries or object files
+static void append_translation_cflags(Array &args, const String &cc) {
 	if (cc.ends_with("zig")) {
 		// Zig cc - C compiler (faster than C++)
 		args.push_back("cc");
 	}
-#if defined(__linux__) || defined(YEP_IS_OSX)
-	args.push_back("-shared");
-	args.push_back("-fPIC");
-	args.push_back("-fvisibility=hidden");
-	args.push_back("-O2");
-	args.push_back("-w");
-	args.push_back("-DCALLBACK_INIT");
-	args.push_back("-o");
-#elif defined(YEP_IS_WINDOWS)
-	if (cc.ends_with("zig")) {
-		// Zig cc - C compiler
-		args.push_back("-shared");
+	if (uses_msvc(cc)) {
+		args.push_back("/O2");
+		args.push_back("/w");
+		args.push_back("/DCALLBACK_INIT");
+	} else {
 		args.push_back("-fPIC");
 		args.push_back("-fvisibility=hidden");
 		args.push_back("-O2");
 		args.push_back("-w");
 		args.push_back("-DCALLBACK_INIT");
-		args.push_back("-o");
-	} else {
+	}
+}
+
+bool Sandbox::compile_translation(const String &code, const String &c99_path, const String &library_path, const String &cc, const String &extra_cflags, bool verbose, const PackedStringArray &objects) {
+	Ref<FileAccess> fa = FileAccess::open(c99_path, FileAccess::ModeFlags::WRITE);
+	if (fa == nullptr || !fa->is_open()) {
+		ERR_PRINT("Sandbox: Failed to open file for writing: " + c99_path);
+		return false;
+	}
+	fa->store_string(code);
+	fa->close();
+	// Compile the generated code
+	Array args;
+	append_translation_cflags(args, cc);
+	if (uses_msvc(cc)) {
 		args.push_back("/LD");
-		args.push_back("/O2");
-		args.push_back("/w");
-		args.push_back("/DCALLBACK_INIT");
 		args.push_back("/Fe");
+	} else {
+		args.push_back("-shared");
+		args.push_back("-o");
 	}
-#endif
-	args.push_back(shared_library_path.replace("res://", ""));
+	args.push_back(library_path);
 	if (!extra_cflags.is_empty())
 		args.append_array(extra_cflags.split(" "));
+	for (const String &object : objects)
+		args.push_back(object);
 	args.push_back(ProjectSettings::get_singleton()->globalize_path(c99_path));
-	UtilityFunctions::print(cc, args);
+	if (verbose)
+		UtilityFunctions::print(cc, args);
 	Array output;
 	int ret = OS::get_singleton()->execute(cc, args, output, true);
 	// Remove the generated C99 file
 	Ref<DirAccess> dir = DirAccess::open("user://");
 	dir->remove(c99_path);
 	if (ret != 0) {
-		ERR_PRINT("Sandbox: Failed to compile generated code: " + shared_library_path);
+		ERR_PRINT("Sandbox: Failed to compile generated code: " + library_path);
 		UtilityFunctions::print(output);
 		return false;
 	}
 	return true;
 }
 
+#ifdef RISCV_BINARY_TRANSLATION
+// Find the ELF programs of a project, skipping hidden directories such as .godot
+static void find_elf_programs(const String &directory, PackedStringArray &programs) {
+	for (const String &file : DirAccess::get_files_at(directory)) {
+		if (file.get_extension() == "elf")
+			programs.push_back(directory.path_join(file));
+	}
+	for (const String &subdirectory : DirAccess::get_directories_at(directory)) {
+		if (!subdirectory.begins_with("."))
+			find_elf_programs(directory.path_join(subdirectory), programs);
+	}
+}
+
+// The translation units of a bundle being compiled on the WorkerThreadPool
+struct BundleCompilation {
+	String cc;
+	std::vector<Array> commands;
+	PackedStringArray programs;
+	std::atomic<bool> failed = false;
+};
+static std::mutex bundle_mutex;
+static BundleCompilation *current_bundle = nullptr;
+
+static void compile_bundle_unit(uint32_t index) {
+	BundleCompilation &bc = *current_bundle;
+	Array output;
+	if (OS::get_singleton()->execute(bc.cc, bc.commands[index], output, true) != 0) {
+		ERR_PRINT("Sandbox: Failed to compile generated code: " + bc.programs[index]);
+		UtilityFunctions::print(output);
+		bc.failed = true;
+	}
+}
+#endif
+
+bool Sandbox::try_compile_binary_translation_bundle(String shared_library_path, const String &cc, const String &extra_cflags, bool ignore_instruction_limit, bool automatic_nbit_as, const Dictionary &translation_options, PackedStringArray programs) {
+#ifdef RISCV_BINARY_TRANSLATION
+	if (!add_shared_library_extension(shared_library_path)) {
+		return false;
+	}
+	// The temporary files of a bundle have fixed names
+	std::lock_guard<std::mutex> lock(bundle_mutex);
+	// The same options as a Sandbox with default settings loading the program
+	riscv::MachineOptions<RISCV_ARCH> options{
+		.memory_max = uint64_t(MAX_VMEM) << 20, // in MiB
+	};
+	options.translate_ignore_instruction_limit = ignore_instruction_limit;
+	options.translate_automatic_nbit_address_space = automatic_nbit_as;
+	if (!apply_translation_options(translation_options, options)) {
+		return false;
+	}
+	if (programs.is_empty()) {
+		find_elf_programs("res://", programs);
+	}
+
+	// 1. Emit the translation of every program into its own translation unit
+	PackedStringArray units;
+	PackedStringArray unit_programs;
+	for (const String &program : programs) {
+		const PackedByteArray binary = FileAccess::get_file_as_bytes(program);
+		String code;
+		try {
+			code = emit_translation_code(std::string_view{ (const char *)binary.ptr(), size_t(binary.size()) }, options);
+		} catch (const std::exception &e) {
+			ERR_PRINT("Sandbox: Failed to emit binary translation of " + program + ": " + String(e.what()));
+		}
+		if (code.is_empty()) {
+			continue;
+		}
+		const String c99_path = "user://temp_sandbox_bundle_" + itos(units.size()) + ".c";
+		Ref<FileAccess> fa = FileAccess::open(c99_path, FileAccess::ModeFlags::WRITE);
+		if (fa == nullptr || !fa->is_open()) {
+			ERR_PRINT("Sandbox: Failed to open file for writing: " + c99_path);
+			continue;
+		}
+		fa->store_string(code);
+		fa->close();
+		units.push_back(c99_path);
+		unit_programs.push_back(program);
+	}
+	if (units.is_empty()) {
+		ERR_PRINT("Sandbox: No programs to translate were found in the project.");
+		return false;
+	}
+
+	// 2. One registration function for the whole library, calling the renamed one of each unit
+	String bundle = "#ifdef _WIN32\n#define BUNDLE_EXPORT __declspec(dllexport)\n#else\n"
+					"#define BUNDLE_EXPORT __attribute__((visibility(\"default\")))\n#endif\n";
+	for (int i = 0; i < units.size(); i++)
+		bundle += "extern void libriscv_init_with_callback8_" + itos(i) + "(void *);\n";
+	bundle += "BUNDLE_EXPORT void libriscv_init_with_callback8(void *callback) {\n";
+	for (int i = 0; i < units.size(); i++)
+		bundle += "\tlibriscv_init_with_callback8_" + itos(i) + "(callback);\n";
+	bundle += "}\n";
+
+	// 3. Compile the units into object files in parallel.
+	// Every symbol of an emitted unit is static, except the registration function which is renamed
+	// for each unit. Common symbols are disabled, so that a unit breaking this fails to link instead
+	// of silently sharing data with another unit.
+	const bool msvc = uses_msvc(cc);
+	PackedStringArray objects;
+	BundleCompilation bc;
+	bc.cc = cc;
+	bc.programs = unit_programs;
+	for (int i = 0; i < units.size(); i++) {
+		const String object = ProjectSettings::get_singleton()->globalize_path(units[i].get_basename() + (msvc ? ".obj" : ".o"));
+		Array args;
+		append_translation_cflags(args, cc);
+		const String rename = "libriscv_init_with_callback8=libriscv_init_with_callback8_" + itos(i);
+		if (msvc) {
+			args.push_back("/c");
+			args.push_back("/D" + rename);
+			args.push_back("/Fo" + object);
+		} else {
+			args.push_back("-c");
+			args.push_back("-fno-common");
+			args.push_back("-D" + rename);
+			args.push_back("-o");
+			args.push_back(object);
+		}
+		if (!extra_cflags.is_empty())
+			args.append_array(extra_cflags.split(" "));
+		args.push_back(ProjectSettings::get_singleton()->globalize_path(units[i]));
+		objects.push_back(object);
+		bc.commands.push_back(std::move(args));
+	}
+	current_bundle = &bc;
+	WorkerThreadPool *pool = WorkerThreadPool::get_singleton();
+	const int64_t group_id = pool->add_group_task(callable_mp_static(&compile_bundle_unit), bc.commands.size(), -1, true, "Sandbox::try_compile_binary_translation_bundle");
+	pool->wait_for_group_task_completion(group_id);
+	current_bundle = nullptr;
+
+	// 4. Link the objects and the registration function into one shared library
+	bool success = false;
+	if (!bc.failed) {
+		success = compile_translation(bundle, "user://temp_sandbox_bundle.c", shared_library_path.replace("res://", ""), cc, extra_cflags, true, objects);
+		if (!success) {
+			ERR_PRINT("Sandbox: Failed to link the bundle. Symbols defined by more than one translation unit must be static.");
+		}
+	}
+	Ref<DirAccess> dir = DirAccess::open("user://");
+	for (int i = 0; i < units.size(); i++) {
+		dir->remove(units[i]);
+		dir->remove(units[i].get_basename() + (msvc ? ".obj" : ".o"));
+	}
+	if (success) {
+		UtilityFunctions::print("Sandbox: Compiled the binary translations of ", units.size(), " programs into ", shared_library_path);
+	}
+	return success;
+#else
+	ERR_PRINT("Sandbox: Binary translation is not enabled.");
+	return false;
+#endif
+}
+
+#if defined(RISCV_BINARY_TRANSLATION) && defined(RISCV_LIBTCC)
+// The commit of libriscv, set by the build system
+#  ifndef LIBRISCV_COMMIT
+#    define LIBRISCV_COMMIT "unknown"
+#  endif
+namespace {
+static constexpr char JIT_CACHE_DIR[] = "user://sandbox_jit_cache/";
+// The translation emitted for a program depends on the extension and the libriscv it was built with,
+// so entries from other libriscv versions are never used. Bump the version when the translations
+// emitted by this extension, or the layout of the entries, change.
+static constexpr char JIT_CACHE_BUILD_TAG[] = "jit-cache-v3 libriscv-" LIBRISCV_COMMIT;
+// Cache entries that have been loaded, or are being compiled, by this process
+static std::mutex jit_cache_mutex;
+static std::unordered_set<std::string> jit_cache_entries;
+static bool jit_cache_compiler_failed = false;
+} //namespace
+
+String Sandbox::get_jit_cache_path(const PackedByteArray &binary) const {
+#  if defined(__linux__)
+	static constexpr char extension[] = ".so";
+#  elif defined(YEP_IS_WINDOWS)
+	static constexpr char extension[] = ".dll";
+#  elif defined(YEP_IS_OSX)
+	static constexpr char extension[] = ".dylib";
+#  else
+	return String();
+#  endif
+	// Content-addressed: the same program with the same translation options gives the same entry
+	Ref<HashingContext> ctx;
+	ctx.instantiate();
+	ctx->start(HashingContext::HASH_SHA256);
+	ctx->update(binary);
+	ctx->update(String(JIT_CACHE_BUILD_TAG).to_utf8_buffer());
+	// The instruction limit is compiled into the translation, unless it is unlimited
+	const String options = String("-r") + itos(m_bintr_register_caching) + "n" + itos(m_bintr_automatic_nbit_as) + "i" + itos(std::max(int64_t(0), get_instructions_max()));
+	return JIT_CACHE_DIR + ctx->finish().hex_encode() + options + extension;
+}
+
+bool Sandbox::load_jit_cache(const String &cache_path) {
+	{
+		std::lock_guard<std::mutex> lock(jit_cache_mutex);
+		// Loaded before, or still being compiled, in this process
+		if (jit_cache_entries.count(cache_path.utf8().get_data()))
+			return false;
+	}
+	if (!FileAccess::file_exists(cache_path)) {
+		return false;
+	}
+	// The cache is written by this extension, so it may be loaded after other instances have been created.
+	// This trusts user://, as documented by the jit_cache project setting.
+	if (!load_binary_translation(cache_path, true)) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(jit_cache_mutex);
+	jit_cache_entries.insert(cache_path.utf8().get_data());
+	return true;
+}
+
+void Sandbox::update_jit_cache(const String &cache_path, const PackedByteArray &binary) {
+	const String compiler = SandboxProjectSettings::get_jit_cache_compiler();
+	{
+		std::lock_guard<std::mutex> lock(jit_cache_mutex);
+		if (jit_cache_compiler_failed || !jit_cache_entries.insert(cache_path.utf8().get_data()).second)
+			return;
+	}
+	DirAccess::make_dir_recursive_absolute(JIT_CACHE_DIR);
+	// Emit the translation with the same options as the JIT, so that it matches the program when loaded
+	riscv::MachineOptions<RISCV_ARCH> options = machine().options();
+	// After the JIT compilations, as it only helps later runs, and is never cancelled
+	CompileScheduler::get().submit(cache_path.hash(), this->m_bintr_priority - 1, nullptr, false, [binary, options = std::move(options), cache_path, compiler]() {
+		const std::string_view binary_view{ (const char *)binary.ptr(), size_t(binary.size()) };
+		const String code = emit_translation_code(binary_view, options);
+		const String library_path = ProjectSettings::get_singleton()->globalize_path(cache_path);
+		// Compile next to the entry and move it into place, so that other processes never load a partial library
+		const String temp_name = "-" + itos(OS::get_singleton()->get_process_id()) + ".tmp";
+		const String temp_path = library_path.get_basename() + temp_name + "." + library_path.get_extension();
+		if (code.is_empty() || !compile_translation(code, cache_path.get_basename() + temp_name + ".c", temp_path, compiler, "", false)) {
+			// Most likely there is no compiler, so stop trying
+			DirAccess::remove_absolute(temp_path);
+			std::lock_guard<std::mutex> lock(jit_cache_mutex);
+			jit_cache_compiler_failed = true;
+			return;
+		}
+		if (DirAccess::rename_absolute(temp_path, library_path) != Error::OK) {
+			ERR_PRINT("Sandbox: Failed to move the compiled translation into the JIT cache: " + library_path);
+			DirAccess::remove_absolute(temp_path);
+		}
+	});
+}
+
+void Sandbox::set_binary_translation_priority(int priority) {
+	this->m_bintr_priority = priority;
+	CompileScheduler::get().set_priority(this, priority);
+}
+
+void Sandbox::count_tiered_calls(int64_t calls) {
+	this->m_bintr_tier_calls += calls;
+	if (this->m_bintr_tier_calls >= this->m_bintr_tier_threshold) {
+		// Other instances sharing the execute segment may already have promoted it. The deferred job
+		// cannot have been cancelled, as this instance owns it.
+		CompileScheduler::get().promote(this->m_bintr_tier_key, this->m_bintr_priority);
+		this->m_bintr_tier_key = 0;
+	}
+}
+#endif // RISCV_BINARY_TRANSLATION && RISCV_LIBTCC
+
+Dictionary Sandbox::get_background_compilations() {
+	const CompileScheduler &scheduler = CompileScheduler::get();
+	Dictionary result;
+	result["queued"] = int64_t(scheduler.get_queued_jobs());
+	result["deferred"] = int64_t(scheduler.get_deferred_jobs());
+	result["workers"] = int64_t(scheduler.get_worker_count());
+	return result;
+}
+
 bool Sandbox::is_binary_translated() const {
 	// Get main execute segment
 	auto &main_seg = this->m_machine->memory.exec_segment_for(this->m_machine->memory.start_address());
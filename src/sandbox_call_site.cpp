@@ -0,0 +1,198 @@
+#include "sandbox_call_site.h"
+
+#include "guest_datatypes.h"
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/core/object.hpp>
+
+void SandboxCallSite::_bind_methods() {
+	{
+		MethodInfo mi;
+		mi.name = "call";
+		mi.return_val = PropertyInfo(Variant::OBJECT, "result");
+		ClassDB::bind_vararg_method(METHOD_FLAGS_DEFAULT, "call", &SandboxCallSite::call, mi, DEFVAL(std::vector<Variant>{}));
+	}
+	ClassDB::bind_method(D_METHOD("is_valid"), &SandboxCallSite::is_valid);
+	ClassDB::bind_method(D_METHOD("get_address"), &SandboxCallSite::get_address);
+}
+
+bool SandboxCallSite::init(Sandbox *sandbox, gaddr_t address, const PackedInt32Array &argument_types, Variant::Type return_type) {
+	m_slots.clear();
+	m_slots.reserve(argument_types.size());
+	// Same register assignment as Sandbox::setup_arguments_native()
+	// Functions returning in registers take their first argument in A0
+	uint8_t index = sandbox->unboxed_return_type_of(address) == Variant::VARIANT_MAX ? 11 : 10;
+	uint8_t flindex = 10;
+	for (int i = 0; i < argument_types.size(); i++) {
+		const Variant::Type type = Variant::Type(argument_types[i]);
+		switch (type) {
+			case Variant::BOOL:
+			case Variant::INT:
+			case Variant::VECTOR2I:
+				m_slots.push_back({ type, ARG_REG_INT, index++ });
+				break;
+			case Variant::FLOAT:
+				m_slots.push_back({ type, ARG_REG_DOUBLE, flindex++ });
+				break;
+			case Variant::VECTOR2:
+				m_slots.push_back({ type, ARG_REG_VEC2, flindex });
+				flindex += 2;
+				break;
+			case Variant::VECTOR3:
+			case Variant::VECTOR3I:
+			case Variant::VECTOR4:
+			case Variant::VECTOR4I:
+			case Variant::COLOR:
+			case Variant::PLANE:
+				m_slots.push_back({ type, ARG_REG_PAIR, index });
+				index += 2;
+				break;
+			case Variant::OBJECT:
+				m_slots.push_back({ type, ARG_REG_OBJECT, index++ });
+				break;
+			case Variant::ARRAY:
+			case Variant::DICTIONARY:
+			case Variant::STRING:
+			case Variant::STRING_NAME:
+			case Variant::NODE_PATH:
+			case Variant::RID:
+			case Variant::CALLABLE:
+			case Variant::TRANSFORM2D:
+			case Variant::BASIS:
+			case Variant::TRANSFORM3D:
+			case Variant::QUATERNION:
+			case Variant::PACKED_BYTE_ARRAY:
+			case Variant::PACKED_FLOAT32_ARRAY:
+			case Variant::PACKED_FLOAT64_ARRAY:
+			case Variant::PACKED_INT32_ARRAY:
+			case Variant::PACKED_INT64_ARRAY:
+			case Variant::PACKED_VECTOR2_ARRAY:
+			case Variant::PACKED_VECTOR3_ARRAY:
+			case Variant::PACKED_VECTOR4_ARRAY:
+			case Variant::PACKED_COLOR_ARRAY:
+			case Variant::PACKED_STRING_ARRAY:
+				m_slots.push_back({ type, ARG_REG_SCOPED, index++ });
+				break;
+			default: // NIL (any Variant) and remaining types are passed by reference
+				m_slots.push_back({ type, ARG_STACK_VARIANT, index++ });
+				break;
+		}
+	}
+	if (index > 18 || flindex > 18) {
+		ERR_PRINT("SandboxCallSite: Too many arguments for VM function call (register overflow)");
+		m_slots.clear();
+		return false;
+	}
+	m_sandbox_id = sandbox->get_instance_id();
+	m_program_generation = sandbox->get_program_generation();
+	m_address = address;
+	m_return_type = return_type;
+	return true;
+}
+
+Sandbox *SandboxCallSite::get_sandbox() const {
+	Sandbox *sandbox = Object::cast_to<Sandbox>(ObjectDB::get_instance(m_sandbox_id));
+	if (sandbox == nullptr || m_address == 0 || sandbox->get_program_generation() != m_program_generation) {
+		return nullptr;
+	}
+	return sandbox;
+}
+
+bool SandboxCallSite::is_valid() const {
+	return this->get_sandbox() != nullptr;
+}
+
+Variant SandboxCallSite::call(const Variant **args, GDExtensionInt arg_count, GDExtensionCallError &error) {
+	Sandbox *sandbox = this->get_sandbox();
+	if (sandbox == nullptr) {
+		ERR_PRINT("SandboxCallSite: The Sandbox was freed or has loaded another program.");
+		error.error = GDEXTENSION_CALL_ERROR_INSTANCE_IS_NULL;
+		return Variant();
+	}
+	if (arg_count != GDExtensionInt(m_slots.size())) {
+		error.error = arg_count < GDExtensionInt(m_slots.size()) ? GDEXTENSION_CALL_ERROR_TOO_FEW_ARGUMENTS : GDEXTENSION_CALL_ERROR_TOO_MANY_ARGUMENTS;
+		error.expected = m_slots.size();
+		return Variant();
+	}
+	for (int i = 0; i < arg_count; i++) {
+		const Variant::Type type = m_slots[i].type;
+		if (type != Variant::NIL && args[i]->get_type() != type) {
+			error.error = GDEXTENSION_CALL_ERROR_INVALID_ARGUMENT;
+			error.argument = i;
+			error.expected = type;
+			return Variant();
+		}
+	}
+	error.error = GDEXTENSION_CALL_OK;
+	return sandbox->vmcall_internal(m_address, args, arg_count, this);
+}
+
+GuestVariant *SandboxCallSite::setup_arguments(Sandbox &emu, gaddr_t &sp, const Variant **args, int argc) const {
+	machine_t &machine = emu.machine();
+	sp -= sizeof(GuestVariant) * (argc + 1);
+	sp &= ~gaddr_t(0xF); // re-align stack pointer
+	const gaddr_t arrayDataPtr = sp;
+	GuestVariant *v = machine.memory.memarray<GuestVariant>(arrayDataPtr, argc + 1);
+	// A0 is the return value (Variant) of the function,
+	// unless it was assigned to an argument for a function returning in registers
+	machine.cpu.reg(10) = arrayDataPtr;
+
+	for (int i = 0; i < argc; i++) {
+		const ArgumentSlot &slot = m_slots[i];
+		const Variant &arg = *args[i];
+		const GDNativeVariant *inner = (const GDNativeVariant *)arg._native_ptr();
+		switch (slot.kind) {
+			case ARG_REG_INT:
+				machine.cpu.reg(slot.reg) = inner->value;
+				break;
+			case ARG_REG_DOUBLE:
+				machine.cpu.registers().getfl(slot.reg).set_double(inner->flt);
+				break;
+			case ARG_REG_VEC2:
+				machine.cpu.registers().getfl(slot.reg + 0).set_float(inner->vec2_flt[0]);
+				machine.cpu.registers().getfl(slot.reg + 1).set_float(inner->vec2_flt[1]);
+				break;
+			case ARG_REG_PAIR:
+				machine.cpu.reg(slot.reg + 0) = (&inner->value)[0];
+				machine.cpu.reg(slot.reg + 1) = (&inner->value)[1];
+				break;
+			case ARG_REG_OBJECT: {
+				godot::Object *obj = inner->to_object();
+				emu.add_scoped_object(obj);
+				machine.cpu.reg(slot.reg) = uintptr_t(obj);
+				break;
+			}
+			case ARG_REG_SCOPED:
+				machine.cpu.reg(slot.reg) = emu.add_scoped_variant(&arg);
+				break;
+			case ARG_STACK_VARIANT:
+				v[i + 1].set(emu, arg, true);
+				machine.cpu.reg(slot.reg) = arrayDataPtr + (i + 1) * sizeof(GuestVariant);
+				break;
+		}
+	}
+	return &v[0];
+}
+
+Variant SandboxCallSite::decode_return(const Sandbox &emu, const GuestVariant &retvar) const {
+	if (retvar.type == m_return_type) {
+		switch (m_return_type) {
+			case Variant::BOOL:
+				return retvar.v.b;
+			case Variant::INT:
+				return retvar.v.i;
+			case Variant::FLOAT:
+				return retvar.v.f;
+			case Variant::VECTOR2:
+				return Vector2(retvar.v.v2f[0], retvar.v.v2f[1]);
+			case Variant::VECTOR2I:
+				return Vector2i(retvar.v.v2i[0], retvar.v.v2i[1]);
+			case Variant::VECTOR3:
+				return Vector3(retvar.v.v3f[0], retvar.v.v3f[1], retvar.v.v3f[2]);
+			case Variant::VECTOR3I:
+				return Vector3i(retvar.v.v3i[0], retvar.v.v3i[1], retvar.v.v3i[2]);
+			default:
+				break;
+		}
+	}
+	return retvar.toVariant(emu);
+}
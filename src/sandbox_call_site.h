@@ -0,0 +1,82 @@
+#pragma once
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+#include <vector>
+
+#include "sandbox.h"
+
+using namespace godot;
+struct GuestVariant;
+
+/**
+ * @brief A pre-bound call to a guest function with a declared type signature.
+ *
+ * The function address, the register and stack layout of the declared argument types,
+ * and the return type are resolved once when the call site is created. Calls through it
+ * avoid hashing the function name and looking up its address, and primitive arguments and
+ * return values are transferred without going through the generic Variant conversions.
+ * Arguments are passed unboxed, like the `unboxed_arguments` mode. Arguments declared as
+ * NIL are passed as Variant.
+ **/
+class SandboxCallSite : public RefCounted {
+	GDCLASS(SandboxCallSite, RefCounted);
+
+protected:
+	static void _bind_methods();
+
+public:
+	/// @brief Call the guest function. The arguments must match the declared argument types.
+	/// @param args The arguments to pass to the function.
+	/// @param arg_count The number of arguments.
+	/// @param error The error code, if any.
+	/// @return The return value of the function call.
+	Variant call(const Variant **args, GDExtensionInt arg_count, GDExtensionCallError &error);
+
+	/// @brief Check if the call site is bound to a Sandbox and a function.
+	/// A call site is no longer valid once the Sandbox loads or reloads a program.
+	/// @return True if the call site can be called, false otherwise.
+	bool is_valid() const;
+
+	/// @brief Get the address of the guest function.
+	/// @return The address of the guest function.
+	gaddr_t get_address() const { return m_address; }
+
+	/// @brief Bind the call site to a function in a Sandbox.
+	/// @param sandbox The Sandbox that the function is called in.
+	/// @param address The address of the function.
+	/// @param argument_types The declared Variant types of the arguments.
+	/// @param return_type The declared Variant type of the return value.
+	/// @return True if the signature is supported, false otherwise.
+	bool init(Sandbox *sandbox, gaddr_t address, const PackedInt32Array &argument_types, Variant::Type return_type);
+
+	/// @brief Set up the arguments according to the precomputed layout. Called by Sandbox::vmcall_internal().
+	GuestVariant *setup_arguments(Sandbox &emu, gaddr_t &sp, const Variant **args, int argc) const;
+	/// @brief Decode the return value according to the declared return type.
+	Variant decode_return(const Sandbox &emu, const GuestVariant &retvar) const;
+
+private:
+	enum ArgumentKind : uint8_t {
+		ARG_REG_INT, // Value in one integer register
+		ARG_REG_DOUBLE, // Value in one floating-point register
+		ARG_REG_VEC2, // Two floats in two floating-point registers
+		ARG_REG_PAIR, // 16-byte struct in two integer registers
+		ARG_REG_OBJECT, // Object pointer in one integer register
+		ARG_REG_SCOPED, // Scoped Variant index in one integer register
+		ARG_STACK_VARIANT, // GuestVariant on the stack, passed by reference
+	};
+	struct ArgumentSlot {
+		Variant::Type type;
+		ArgumentKind kind;
+		uint8_t reg;
+	};
+
+	// The function address is only valid for the program it was resolved in
+	Sandbox *get_sandbox() const;
+
+	uint64_t m_sandbox_id = 0;
+	uint64_t m_program_generation = 0;
+	gaddr_t m_address = 0;
+	Variant::Type m_return_type = Variant::NIL;
+	std::vector<ArgumentSlot> m_slots;
+};
@@ -52,6 +52,10 @@ bool Sandbox::resume(uint64_t max_instructions) {
 		ERR_PRINT("Sandbox: Cannot resume after initialization.");
 		return false;
 	}
+	if (!this->m_forks.empty()) {
+		ERR_PRINT("Sandbox: Cannot resume a sandbox that has been forked from.");
+		return false;
+	}
 	if (this->m_current_state != &this->m_states[0]) {
 		ERR_PRINT("Sandbox: Cannot resume while in a call.");
 		this->m_resumable_mode = false; // Disable resumable mode
@@ -113,6 +113,7 @@ String Sandbox::generate_api(String language, String header, bool use_argument_n
 
 static String emit_class(ClassDBSingleton *class_db, const HashSet<String> &cpp_keywords, const HashSet<String> &singletons, const String &class_name, bool use_argument_names) {
 	// Generate a simple API for each class using METHOD() and PROPERTY() macros to a string.
+	// Names are compile-time constants, so the interned variants of the macros are used.
 	if constexpr (VERBOSE) {
 		UtilityFunctions::print("* Currently generating: " + class_name);
 	}
@@ -149,9 +150,9 @@ static String emit_class(ClassDBSingleton *class_db, const HashSet<String> &cpp_
 
 		String property_type = cpp_compatible_variant_type(type);
 		if (property_type == "Variant") {
-			api += String("    PROPERTY(") + property_name + ", Variant);\n";
+			api += String("    INTERNED_PROPERTY(") + property_name + ", Variant);\n";
 		} else {
-			api += String("    PROPERTY(") + property_name + ", " + property_type + ");\n";
+			api += String("    INTERNED_PROPERTY(") + property_name + ", " + property_type + ");\n";
 		}
 	}
 	TypedArray<Dictionary> methods = class_db->class_get_method_list(class_name, true);
@@ -316,13 +317,14 @@ static String emit_class(ClassDBSingleton *class_db, const HashSet<String> &cpp_
 			// TODO: Append const if the method is const.
 			// Sadly, it breaks the call operator, so hold off on this for now.
 			api += ") {\n";
-			// Method body: return operator() (\"" + method_name + "\"", " + argument_list + ");\n";
+			// Method body: return call(_interned_method, " + argument_list + ");\n";
+			api += "      static const InternedName _interned_method(\"" + method_name + "\");\n";
 			if (is_void) {
 				// Void return type.
-				api += "      voidcall(\"" + method_name + "\"";
+				api += "      voidcall(_interned_method";
 			} else {
 				// Typed return type.
-				api += "      return operator() (\"" + method_name + "\"";
+				api += "      return call(_interned_method";
 			}
 			if (!arguments.is_empty()) {
 				api += ", ";
@@ -342,9 +344,9 @@ static String emit_class(ClassDBSingleton *class_db, const HashSet<String> &cpp_
 
 		// Typed return type.
 		if (is_void) {
-			api += String("    METHOD(void, ") + method_name + ");\n";
+			api += String("    INTERNED_METHOD(void, ") + method_name + ");\n";
 		} else {
-			api += String("    METHOD(") + cpp_compatible_variant_type(type) + ", " + method_name + ");\n";
+			api += String("    INTERNED_METHOD(") + cpp_compatible_variant_type(type) + ", " + method_name + ");\n";
 		}
 	}
 
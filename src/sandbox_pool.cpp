@@ -0,0 +1,91 @@
+#include "sandbox_pool.h"
+
+#include "sandbox.h"
+#include <algorithm>
+#include <godot_cpp/core/class_db.hpp>
+
+void SandboxPool::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("acquire"), &SandboxPool::acquire);
+	ClassDB::bind_method(D_METHOD("release", "sandbox"), &SandboxPool::release);
+	ClassDB::bind_method(D_METHOD("get_idle_count"), &SandboxPool::get_idle_count);
+	ClassDB::bind_method(D_METHOD("clear"), &SandboxPool::clear);
+
+	ClassDB::bind_method(D_METHOD("set_program", "program"), &SandboxPool::set_program);
+	ClassDB::bind_method(D_METHOD("get_program"), &SandboxPool::get_program);
+	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "program", PROPERTY_HINT_RESOURCE_TYPE, "ELFScript"), "set_program", "get_program");
+
+	ClassDB::bind_method(D_METHOD("set_max_idle", "max"), &SandboxPool::set_max_idle);
+	ClassDB::bind_method(D_METHOD("get_max_idle"), &SandboxPool::get_max_idle);
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "max_idle", PROPERTY_HINT_NONE, "Maximum number of idle instances kept by the pool"), "set_max_idle", "get_max_idle");
+}
+
+void SandboxPool::set_program(Ref<ELFScript> program) {
+	if (m_program == program)
+		return;
+	this->clear();
+	m_program = program;
+}
+
+void SandboxPool::set_max_idle(int max) {
+	m_max_idle = MAX(max, 0);
+	while (int(m_idle.size()) > m_max_idle) {
+		memdelete(m_idle.back());
+		m_idle.pop_back();
+	}
+}
+
+Sandbox *SandboxPool::acquire() {
+	if (m_program.is_null()) {
+		ERR_PRINT("SandboxPool: No program set.");
+		return nullptr;
+	}
+	while (!m_idle.empty()) {
+		Sandbox *sandbox = m_idle.back();
+		m_idle.pop_back();
+		// Idle instances are unloaded when the program is reloaded
+		if (sandbox->has_program_loaded() || sandbox->fork_from_template(m_program)) {
+			return sandbox;
+		}
+		memdelete(sandbox);
+	}
+	return Sandbox::FromTemplate(m_program);
+}
+
+void SandboxPool::release(Sandbox *sandbox) {
+	if (sandbox == nullptr)
+		return;
+	if (std::find(m_idle.begin(), m_idle.end(), sandbox) != m_idle.end()) {
+		ERR_PRINT("SandboxPool: Sandbox was already released.");
+		return;
+	}
+	if (sandbox->is_in_vmcall()) {
+		// Rewinding the instance would pull the memory out from under the running call
+		ERR_PRINT("SandboxPool: Cannot release a Sandbox while a VM call is in progress.");
+		return;
+	}
+	if (sandbox->get_program() != m_program) {
+		ERR_PRINT("SandboxPool: Released Sandbox does not run the pooled program.");
+		return;
+	}
+	if (Node *parent = sandbox->get_parent()) {
+		parent->remove_child(sandbox);
+	}
+	// Rewind to the initialized state by forking the template again,
+	// which only discards the pages this instance has written to.
+	if (int(m_idle.size()) >= m_max_idle || !sandbox->fork_from_template(m_program)) {
+		memdelete(sandbox);
+		return;
+	}
+	m_idle.push_back(sandbox);
+}
+
+void SandboxPool::clear() {
+	for (Sandbox *sandbox : m_idle) {
+		memdelete(sandbox);
+	}
+	m_idle.clear();
+}
+
+SandboxPool::~SandboxPool() {
+	this->clear();
+}
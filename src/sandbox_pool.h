@@ -0,0 +1,60 @@
+#pragma once
+
+#include <godot_cpp/classes/resource.hpp>
+#include <vector>
+
+#include "elf/script_elf.h"
+
+using namespace godot;
+class Sandbox;
+
+/**
+ * @brief A pool of pre-initialized Sandbox instances running the same program.
+ *
+ * Sandboxes are forked from the program's template instance (see Sandbox::fork_from),
+ * so they start out sharing the post-main() memory copy-on-write. When a Sandbox is
+ * released back to the pool, it is rewound by re-forking the template, which drops
+ * only the pages it dirtied. The Sandbox node itself is kept and handed out again.
+ **/
+class SandboxPool : public Resource {
+	GDCLASS(SandboxPool, Resource);
+
+protected:
+	static void _bind_methods();
+
+public:
+	static constexpr int MAX_IDLE = 32; // Default maximum number of idle instances
+
+	/// @brief Set the program that pooled instances run. Clears the pool.
+	/// @param program The program to run.
+	void set_program(Ref<ELFScript> program);
+	/// @brief Get the program that pooled instances run.
+	/// @return The program.
+	Ref<ELFScript> get_program() const { return m_program; }
+
+	/// @brief Set the maximum number of idle instances kept by the pool.
+	/// @param max The maximum number of idle instances.
+	void set_max_idle(int max);
+	int get_max_idle() const { return m_max_idle; }
+
+	/// @brief Take an initialized Sandbox instance from the pool, creating one if the pool is empty.
+	/// @return A Sandbox instance owned by the caller until it is released.
+	Sandbox *acquire();
+	/// @brief Give a Sandbox instance back to the pool, rewinding it to its initialized state.
+	/// Releasing an instance twice, or while it is in a VM call, is an error and is ignored.
+	/// @param sandbox The Sandbox instance, which must have been acquired from this pool.
+	void release(Sandbox *sandbox);
+
+	/// @brief Get the number of idle instances in the pool.
+	/// @return The number of idle instances.
+	int get_idle_count() const { return int(m_idle.size()); }
+	/// @brief Free all idle instances in the pool.
+	void clear();
+
+	~SandboxPool();
+
+private:
+	Ref<ELFScript> m_program;
+	std::vector<Sandbox *> m_idle;
+	int m_max_idle = MAX_IDLE;
+};
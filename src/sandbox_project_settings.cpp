@@ -20,6 +20,10 @@ static constexpr char SCONS_PATH_HINT[] = "Path to the SConstruct executable";
 
 static constexpr char ASYNC_COMPILATION[] = "editor/script/async_compilation";
 static constexpr char ASYNC_COMPILATION_HINT[] = "Compile scripts asynchronously";
+static constexpr char JIT_CACHE[] = "editor/script/jit_cache";
+static constexpr char JIT_CACHE_HINT[] = "Compile JIT-translated programs with the system compiler into user://, and load them in later runs. The cached native libraries are loaded even after Sandbox instances exist, so enabling this trusts everything that can write to user://";
+static constexpr char JIT_CACHE_COMPILER[] = "editor/script/jit_cache_compiler";
+static constexpr char JIT_CACHE_COMPILER_HINT[] = "Path to the C compiler used for the JIT cache";
 static constexpr char NATIVE_TYPES[] = "editor/script/unboxed_types_for_sandbox_arguments";
 static constexpr char NATIVE_TYPES_HINT[] = "Use native types and classes instead of Variants in Sandbox functions where possible";
 static constexpr char DEBUG_INFO[] = "editor/script/debug_info";
@@ -88,6 +92,8 @@ void SandboxProjectSettings::register_settings() {
 	register_setting_plain(SCONS_PATH, "scons", SCONS_PATH_HINT, true);
 	register_setting_plain(CMAKE_PATH, "cmake", CMAKE_PATH_HINT, true);
 	register_setting_plain(ASYNC_COMPILATION, true, ASYNC_COMPILATION_HINT, false);
+	register_setting_plain(JIT_CACHE, false, JIT_CACHE_HINT, false);
+	register_setting_plain(JIT_CACHE_COMPILER, "cc", JIT_CACHE_COMPILER_HINT, false);
 	register_setting_plain(NATIVE_TYPES, true, NATIVE_TYPES_HINT, false);
 	register_setting_plain(DEBUG_INFO, false, DEBUG_INFO_HINT, false);
 	register_setting_plain(GLOBAL_DEFINES, Array(), GLOBAL_DEFINES_HINT, false);
@@ -152,6 +158,14 @@ bool SandboxProjectSettings::async_compilation() {
 	return get_setting<bool>(ASYNC_COMPILATION);
 }
 
+bool SandboxProjectSettings::use_jit_cache() {
+	return get_setting<bool>(JIT_CACHE);
+}
+
+String SandboxProjectSettings::get_jit_cache_compiler() {
+	return get_setting<String>(JIT_CACHE_COMPILER);
+}
+
 bool SandboxProjectSettings::use_native_types() {
 	return get_setting<bool>(NATIVE_TYPES);
 }
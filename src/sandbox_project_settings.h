@@ -19,6 +19,9 @@ public:
 
 	static bool async_compilation();
 
+	static bool use_jit_cache();
+	static String get_jit_cache_compiler();
+
 	static bool use_native_types();
 
 	static bool debug_info();
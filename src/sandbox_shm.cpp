@@ -1,4 +1,10 @@
 #include "sandbox.h"
+
+#include "syscalls.h"
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <numeric>
 static constexpr bool VERBOSE_SHM = false;
 
 gaddr_t Sandbox::share_array_internal(void* data, size_t bytes, bool allow_write)
@@ -14,10 +20,18 @@ gaddr_t Sandbox::share_array_internal(void* data, size_t bytes, bool allow_write
 		}
 #endif
 
-	const gaddr_t vaddr = this->m_shared_memory_base;
+	const gaddr_t vaddr = this->map_shared_memory(data, bytes, allow_write);
+	if (vaddr != 0) {
+		// Add the new range to the shared memory ranges (we need the real bytes)
+		this->m_shared_memory_ranges.emplace(vaddr, SharedMemoryRange(vaddr, bytes, data));
+	}
+	return vaddr;
+}
+
+gaddr_t Sandbox::map_shared_memory(void *data, size_t bytes, bool allow_write) {
 	const size_t  vsize = (bytes + 0xFFFLL) & ~0xFFFLL; // Align to 4KB
-	// The address space is practically endless, so we can just keep allocating
-	this->m_shared_memory_base += vsize;
+	// Reuses the addresses of unshared ranges, so that the page tables stay bounded
+	const gaddr_t vaddr = this->m_shared_memory_allocator.allocate(vsize);
 
 	// Figure out the page-sized portion of the data
 	const size_t valignsize = bytes & ~0xFFFLL; // Align to 4KB
@@ -52,60 +66,255 @@ gaddr_t Sandbox::share_array_internal(void* data, size_t bytes, bool allow_write
 			// And the remaining bytes internal to the page are already zeroed (or guest-owned).
 		}
 
-		// Add the new range to the shared memory ranges (we need the real bytes)
-		this->m_shared_memory_ranges.emplace_back(vaddr, bytes, data);
 		return vaddr;
 
 	} catch (const std::exception &e) {
 		ERR_PRINT(String("Failed to share array: ") + e.what());
 
-		// If we failed to share the array, we need to reset the base address
-		this->m_shared_memory_base -= vsize;
+		// If we failed to share the array, we need to give back the range
+		this->unmap_shared_memory(vaddr, bytes);
 		return 0;
 	}
 }
 
+void Sandbox::unmap_shared_memory(gaddr_t address, size_t bytes) {
+	// Align up the size to page size
+	const size_t aligned_size = (bytes + riscv::Page::size() - 1) & ~(riscv::Page::size() - 1);
+	if (aligned_size == 0) {
+		return;
+	}
+	if constexpr (VERBOSE_SHM) {
+		printf("Freeing pages from shared memory range: start=0x%lx, size=0x%lx\n", long(address), long(aligned_size));
+	}
+	machine().memory.free_pages(address, aligned_size);
+	this->m_shared_memory_allocator.free(address, aligned_size);
+}
+
+int64_t Sandbox::page_padded_size(int64_t element_count, int64_t element_size) {
+	if (element_count < 0 || element_size <= 0) {
+		ERR_PRINT("Invalid element count or element size.");
+		return element_count;
+	}
+	// The smallest number of whole elements that fills whole pages, eg. 1024 Vector3s fill 3 pages
+	const int64_t page_size = riscv::Page::size();
+	const int64_t step = page_size / std::gcd(element_size, page_size);
+	return (element_count + step - 1) / step * step;
+}
+
 bool Sandbox::unshare_array(gaddr_t address) {
 	if (this->is_in_vmcall()) {
 		ERR_PRINT("Cannot unshare array while a VM call is in progress.");
 		return false;
 	}
 
-	auto it = std::find_if(this->m_shared_memory_ranges.begin(), this->m_shared_memory_ranges.end(),
-		[address](const auto &range) { return range.contains(address); });
-
-	if (it == this->m_shared_memory_ranges.end()) {
+	// Find the range that starts at or before the address
+	auto it = this->m_shared_memory_ranges.upper_bound(address);
+	if (it == this->m_shared_memory_ranges.begin() || !std::prev(it)->second.contains(address)) {
 		ERR_PRINT("Address is not in a shared memory range.");
 		return false;
 	}
+	const SharedMemoryRange &range = std::prev(it)->second;
 
 	// Copy back the remaining bytes (overflow on the last page) if any
-	const size_t remaining = it->size & (riscv::Page::size() - 1);
+	const size_t remaining = range.size & (riscv::Page::size() - 1);
 	if (remaining > 0) {
 		if constexpr (VERBOSE_SHM) {
-			printf("Copying remaining %zu bytes from shared memory at address 0x%lx\n", remaining, long(it->start + it->size - remaining));
+			printf("Copying remaining %zu bytes from shared memory at address 0x%lx\n", remaining, long(range.start + range.size - remaining));
 		}
 		// Get the base pointer to the shared memory range by getting the page data at start
-		uint8_t *base_ptr = (uint8_t *)it->base_ptr;
+		uint8_t *base_ptr = (uint8_t *)range.base_ptr;
 
-		const gaddr_t offset = it->size - remaining;
+		const gaddr_t offset = range.size - remaining;
 		machine().copy_from_guest(
-			base_ptr + offset, it->start + offset, remaining);
+			base_ptr + offset, range.start + offset, remaining);
 	}
 
-	// Remove the range from the shared memory ranges
-	if constexpr (VERBOSE_SHM) {
-		printf("Freeing pages from shared memory range: start=0x%lx, size=0x%lx\n", long(it->start), long(it->size));
+	// Free the pages in the range, and remove it from the shared memory ranges
+	this->unmap_shared_memory(range.start, range.size);
+	this->m_shared_memory_ranges.erase(std::prev(it));
+	return true;
+}
+
+
+gaddr_t Sandbox::view_array_internal(Variant &&array, const void *data, size_t bytes) {
+#ifdef RISCV_LIBTCC
+	if (this->m_bintr_automatic_nbit_as) {
+		ERR_PRINT("Cannot view array while the program is in automatic N-bit mode. Virtual memory is disabled.");
+		return 0;
 	}
-	// Align up the size to page size
-	const size_t aligned_size = (it->size + riscv::Page::size() - 1) & ~(riscv::Page::size() - 1);
-	// Free the pages in the range
-	machine().memory.free_pages(it->start, aligned_size);
+#endif
+	// Viewing the same array again in the same call gives the same mapping
+	for (auto it = this->m_array_views.rbegin(); it != this->m_array_views.rend() && it->level == this->m_level; ++it) {
+		if (it->data == data && it->size == bytes)
+			return it->start;
+	}
+	if (this->m_array_views.size() >= MAX_ARRAY_VIEWS) {
+		ERR_PRINT("Too many array views in progress.");
+		return 0;
+	}
+	// The guest cannot write to the view, so the host array is never modified
+	const gaddr_t vaddr = this->map_shared_memory(const_cast<void *>(data), bytes, false);
+	if (vaddr != 0) {
+		// Holding a reference to the array keeps its data alive and unchanged until the view is released,
+		// as writes through other references will copy the data first
+		this->m_array_views.push_back(ArrayView{ vaddr, gaddr_t(bytes), this->m_level, data, std::move(array) });
+	}
+	return vaddr;
+}
+
+void Sandbox::release_array_views(uint32_t level) {
+	while (!this->m_array_views.empty() && this->m_array_views.back().level >= level) {
+		const ArrayView &view = this->m_array_views.back();
+		if constexpr (VERBOSE_SHM) {
+			printf("Releasing array view: start=0x%lx, size=0x%lx\n", long(view.start), long(view.size));
+		}
+		// Nothing to copy back, as the view is read-only
+		this->unmap_shared_memory(view.start, view.size);
+		this->m_array_views.pop_back();
+	}
+}
+
+namespace {
+static constexpr size_t CHANNEL_HEAD = size_t(Channel_Layout::HEAD);
+static constexpr size_t CHANNEL_TAIL = size_t(Channel_Layout::TAIL);
+static constexpr size_t CHANNEL_DATA = size_t(Channel_Layout::DATA);
+
+static std::atomic_ref<uint64_t> channel_counter(uint8_t *channel, size_t offset) {
+	return std::atomic_ref<uint64_t>(*reinterpret_cast<uint64_t *>(channel + offset));
+}
+// Copy into or out of the ring buffer, wrapping around at the end
+static void channel_write(uint8_t *channel, uint32_t capacity, uint64_t position, const void *src, size_t size) {
+	const size_t offset = position & (capacity - 1);
+	const size_t first = std::min<size_t>(size, capacity - offset);
+	std::memcpy(channel + CHANNEL_DATA + offset, src, first);
+	std::memcpy(channel + CHANNEL_DATA, static_cast<const uint8_t *>(src) + first, size - first);
+}
+static void channel_read(uint8_t *channel, uint32_t capacity, uint64_t position, void *dst, size_t size) {
+	const size_t offset = position & (capacity - 1);
+	const size_t first = std::min<size_t>(size, capacity - offset);
+	std::memcpy(dst, channel + CHANNEL_DATA + offset, first);
+	std::memcpy(static_cast<uint8_t *>(dst) + first, channel + CHANNEL_DATA, size - first);
+}
+} //namespace
+
+gaddr_t Sandbox::open_channel(int64_t capacity) {
+	if (capacity <= 0 || capacity > MAX_CHANNEL_CAPACITY) {
+		ERR_PRINT("Channel capacity must be between 1 and " + itos(MAX_CHANNEL_CAPACITY) + " bytes.");
+		return 0;
+	}
+#ifdef RISCV_LIBTCC
+	if (this->m_bintr_automatic_nbit_as) {
+		ERR_PRINT("Cannot open channel while the program is in automatic N-bit mode. Virtual memory is disabled.");
+		return 0;
+	}
+#endif
+	// A power of two capacity turns positions into offsets with a mask
+	const uint32_t data_size = std::bit_ceil(std::max<uint32_t>(uint32_t(capacity), 64));
+	// Whole pages are mapped, so that no bytes need to be copied between host and guest
+	const size_t size = (CHANNEL_DATA + data_size + riscv::Page::size() - 1) & ~(riscv::Page::size() - 1);
+
+	Channel channel{ 0, gaddr_t(size), data_size, std::make_unique<uint64_t[]>(size / sizeof(uint64_t)) };
+	uint8_t *memory = reinterpret_cast<uint8_t *>(channel.memory.get());
+	// For the guest only, as the guest may overwrite it
+	*reinterpret_cast<uint32_t *>(memory + size_t(Channel_Layout::CAPACITY)) = data_size;
+
+	channel.address = this->map_shared_memory(memory, size, true);
+	if (channel.address == 0) {
+		return 0;
+	}
+	this->m_channels.push_back(std::move(channel));
+	return this->m_channels.back().address;
+}
+
+bool Sandbox::close_channel(gaddr_t address) {
+	if (this->is_in_vmcall()) {
+		ERR_PRINT("Cannot close channel while a VM call is in progress.");
+		return false;
+	}
+	auto it = std::find_if(this->m_channels.begin(), this->m_channels.end(),
+		[address](const Channel &channel) { return channel.address == address; });
+	if (it == this->m_channels.end()) {
+		ERR_PRINT("Address is not a channel.");
+		return false;
+	}
+	this->unmap_shared_memory(it->address, it->size);
+	this->m_channels.erase(it);
+	return true;
+}
+
+Sandbox::Channel *Sandbox::find_channel(gaddr_t address) {
+	for (Channel &channel : this->m_channels) {
+		if (channel.address == address)
+			return &channel;
+	}
+	ERR_PRINT("Address is not a channel.");
+	return nullptr;
+}
 
-	this->m_shared_memory_ranges.erase(it);
+// The guest can write anything into HEAD, TAIL and the message lengths, so every
+// position and size is checked against the capacity before copying any bytes.
+bool Sandbox::channel_send(gaddr_t address, const PackedByteArray &message) {
+	Channel *found = this->find_channel(address);
+	if (found == nullptr) {
+		return false;
+	}
+	uint8_t *channel = reinterpret_cast<uint8_t *>(found->memory.get());
+	const uint32_t capacity = found->capacity;
+	const uint32_t size = message.size();
+	// The length and payload, padded so that lengths never wrap around the end
+	const uint64_t needed = sizeof(uint32_t) + ((uint64_t(size) + 3) & ~uint64_t(3));
+	if (needed > capacity) {
+		ERR_PRINT("Message is larger than the channel capacity.");
+		return false;
+	}
+	const uint64_t head = channel_counter(channel, CHANNEL_HEAD).load(std::memory_order_relaxed);
+	const uint64_t tail = channel_counter(channel, CHANNEL_TAIL).load(std::memory_order_acquire);
+	if (UNLIKELY(head - tail > capacity)) {
+		ERR_PRINT("Channel is corrupted: more pending data than its capacity.");
+		return false;
+	}
+	if (capacity - (head - tail) < needed) {
+		return false;
+	}
+	channel_write(channel, capacity, head, &size, sizeof(size));
+	channel_write(channel, capacity, head + sizeof(size), message.ptr(), size);
+	// Publish the message to the consumer
+	channel_counter(channel, CHANNEL_HEAD).store(head + needed, std::memory_order_release);
 	return true;
 }
 
+Variant Sandbox::channel_receive(gaddr_t address) {
+	Channel *found = this->find_channel(address);
+	if (found == nullptr) {
+		return Variant();
+	}
+	uint8_t *channel = reinterpret_cast<uint8_t *>(found->memory.get());
+	const uint32_t capacity = found->capacity;
+	const uint64_t tail = channel_counter(channel, CHANNEL_TAIL).load(std::memory_order_relaxed);
+	const uint64_t head = channel_counter(channel, CHANNEL_HEAD).load(std::memory_order_acquire);
+	if (head == tail) {
+		return Variant();
+	}
+	const uint64_t pending = head - tail;
+	if (UNLIKELY(pending > capacity || pending < sizeof(uint32_t))) {
+		ERR_PRINT("Channel is corrupted: pending data does not fit the capacity.");
+		return Variant();
+	}
+	uint32_t size;
+	channel_read(channel, capacity, tail, &size, sizeof(size));
+	if (UNLIKELY(uint64_t(size) + sizeof(uint32_t) > pending)) {
+		// The guest wrote a bad length, so the channel is unusable
+		ERR_PRINT("Channel message is larger than the pending data.");
+		return Variant();
+	}
+	const uint64_t needed = std::min<uint64_t>(sizeof(uint32_t) + ((uint64_t(size) + 3) & ~uint64_t(3)), pending);
+	PackedByteArray message;
+	message.resize(size);
+	channel_read(channel, capacity, tail + sizeof(size), message.ptrw(), size);
+	// Give the space back to the producer
+	channel_counter(channel, CHANNEL_TAIL).store(tail + needed, std::memory_order_release);
+	return message;
+}
 
 gaddr_t Sandbox::share_byte_array(bool allow_write, const PackedByteArray &array) {
 	return this->share_array_internal((void *)array.ptr(), array.size(), allow_write);
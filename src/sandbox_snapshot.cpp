@@ -0,0 +1,221 @@
+#include "sandbox.h"
+
+#include "guest_datatypes.h"
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/hashing_context.hpp>
+static constexpr bool VERBOSE_SNAPSHOT = false;
+// Snapshot file layout (little-endian):
+//   u32 magic, u32 version, u32 hash length, hash bytes (SHA-256 of the ELF), u32 memory_max,
+//   Variant functions, Variant properties, Variant permanent variants, Variant slot generations,
+//   Variant free slots, Variant interned names, u64 image size, image bytes
+static constexpr uint32_t SNAPSHOT_MAGIC = 0x53534447; // "GDSS"
+static constexpr uint32_t SNAPSHOT_VERSION = 5;
+
+static PackedByteArray snapshot_elf_hash(const PackedByteArray &elf) {
+	Ref<HashingContext> ctx;
+	ctx.instantiate();
+	ctx->start(HashingContext::HASH_SHA256);
+	ctx->update(elf);
+	return ctx->finish();
+}
+
+static bool is_serializable_variant(const Variant &var) {
+	switch (var.get_type()) {
+		case Variant::OBJECT:
+		case Variant::CALLABLE:
+		case Variant::SIGNAL:
+		case Variant::RID:
+			return false;
+		default:
+			return true;
+	}
+}
+
+String Sandbox::snapshot_path_for(const String &elf_path) {
+	return elf_path.get_basename() + ".snapshot";
+}
+
+Error Sandbox::save_snapshot(const String &path) const {
+	if (!this->has_program_loaded()) {
+		ERR_PRINT("Sandbox::save_snapshot: No program loaded.");
+		return Error::ERR_UNCONFIGURED;
+	}
+	if (this->is_in_vmcall() || this->is_initializing()) {
+		ERR_PRINT("Cannot save a snapshot while a VM call is in progress.");
+		return Error::ERR_BUSY;
+	}
+	if (!this->m_shared_memory_ranges.empty() || !this->m_channels.empty() || !this->m_states[0].scoped_objects.empty()) {
+		// Host memory and object references are only valid in this process
+		ERR_PRINT("Sandbox::save_snapshot: Cannot snapshot shared memory or object references.");
+		return Error::ERR_UNAVAILABLE;
+	}
+	const PackedByteArray &elf = this->m_program_data.is_valid() ? this->m_program_data->get_content() : this->m_program_bytes;
+
+	// Permanent Variants are referenced by handle from the guest, so all of them must be restored
+	const CurrentState &perm_state = this->m_states[0];
+	Array variants;
+	for (const Variant *var : perm_state.scoped_variants) {
+		if (var == nullptr) {
+			// A freed slot
+			variants.push_back(Variant());
+			continue;
+		}
+		if (!is_serializable_variant(*var)) {
+			ERR_PRINT("Sandbox::save_snapshot: Permanent Variant cannot be serialized: " + Variant::get_type_name(var->get_type()));
+			return Error::ERR_UNAVAILABLE;
+		}
+		variants.push_back(*var);
+	}
+	PackedInt32Array generations;
+	for (const uint16_t generation : perm_state.generations) {
+		generations.push_back(generation);
+	}
+	PackedInt32Array free_slots;
+	for (const uint32_t slot : perm_state.free_slots) {
+		free_slots.push_back(slot);
+	}
+	// Interned names and method handles are also held by the guest, in order of interning
+	PackedStringArray interned_names;
+	for (const StringName &name : this->m_interned_names) {
+		interned_names.push_back(name);
+	}
+	Array properties;
+	for (const SandboxProperty &prop : this->m_properties) {
+		Dictionary dict;
+		dict["name"] = prop.name();
+		dict["type"] = int(prop.type());
+		dict["setter"] = prop.setter_address();
+		dict["getter"] = prop.getter_address();
+		dict["address"] = prop.guest_variant_address();
+		dict["default"] = prop.default_value();
+		properties.push_back(dict);
+	}
+	Array functions;
+	if (this->m_program_data.is_valid()) {
+		functions = this->m_program_data->functions;
+	}
+
+	// Dirty pages, registers and the native heap arena
+	std::vector<uint8_t> image;
+	try {
+		machine().serialize_to(image);
+	} catch (const std::exception &e) {
+		ERR_PRINT("Sandbox::save_snapshot: " + String(e.what()));
+		return Error::FAILED;
+	}
+	PackedByteArray image_bytes;
+	image_bytes.resize(image.size());
+	std::memcpy(image_bytes.ptrw(), image.data(), image.size());
+
+	Ref<FileAccess> fa = FileAccess::open(path, FileAccess::WRITE);
+	if (fa.is_null()) {
+		ERR_PRINT("Sandbox::save_snapshot: Failed to open " + path);
+		return FileAccess::get_open_error();
+	}
+	const PackedByteArray hash = snapshot_elf_hash(elf);
+	fa->store_32(SNAPSHOT_MAGIC);
+	fa->store_32(SNAPSHOT_VERSION);
+	fa->store_32(hash.size());
+	fa->store_buffer(hash);
+	fa->store_32(this->get_memory_max());
+	fa->store_var(functions);
+	fa->store_var(properties);
+	fa->store_var(variants);
+	fa->store_var(generations);
+	fa->store_var(free_slots);
+	fa->store_var(interned_names);
+	fa->store_64(image_bytes.size());
+	fa->store_buffer(image_bytes);
+	const Error err = fa->get_error();
+	if constexpr (VERBOSE_SNAPSHOT) {
+		printf("Sandbox: Saved snapshot %s (%zu bytes image)\n", path.utf8().ptr(), image.size());
+	}
+	return err;
+}
+
+bool Sandbox::load_snapshot(const String &path, const PackedByteArray &elf, ELFSnapshot &snapshot) {
+	if (!FileAccess::file_exists(path)) {
+		return false;
+	}
+	Ref<FileAccess> fa = FileAccess::open(path, FileAccess::READ);
+	if (fa.is_null()) {
+		return false;
+	}
+	if (fa->get_32() != SNAPSHOT_MAGIC || fa->get_32() != SNAPSHOT_VERSION) {
+		WARN_PRINT("Sandbox: Ignoring snapshot with unknown format: " + path);
+		return false;
+	}
+	const uint32_t hash_size = fa->get_32();
+	if (fa->get_buffer(hash_size) != snapshot_elf_hash(elf)) {
+		// The program has been rebuilt since the snapshot was saved
+		if constexpr (VERBOSE_SNAPSHOT) {
+			printf("Sandbox: Ignoring stale snapshot %s\n", path.utf8().ptr());
+		}
+		return false;
+	}
+	ELFSnapshot result;
+	result.memory_max = fa->get_32();
+	result.functions = fa->get_var();
+	result.properties = fa->get_var();
+	result.variants = fa->get_var();
+	result.variant_generations = fa->get_var();
+	result.free_variant_slots = fa->get_var();
+	result.interned_names = fa->get_var();
+	const uint64_t image_size = fa->get_64();
+	const PackedByteArray image = fa->get_buffer(image_size);
+	if (fa->get_error() != Error::OK || uint64_t(image.size()) != image_size) {
+		WARN_PRINT("Sandbox: Ignoring truncated snapshot: " + path);
+		return false;
+	}
+	result.image.assign(image.ptr(), image.ptr() + image.size());
+	snapshot = std::move(result);
+	return true;
+}
+
+bool Sandbox::restore_snapshot() {
+	if (this->m_program_data.is_null() || this->m_resumable_mode)
+		return false;
+	const ELFSnapshot &snapshot = this->m_program_data->get_snapshot();
+	// The guest heap was laid out for a specific arena size
+	if (!snapshot.is_valid() || snapshot.memory_max != this->get_memory_max())
+		return false;
+
+	if (machine().deserialize_from(snapshot.image) != 0) {
+		throw std::runtime_error("Failed to restore the program snapshot");
+	}
+
+	CurrentState &perm_state = this->m_states[0];
+	if (snapshot.variant_generations.size() != snapshot.variants.size()) {
+		throw std::runtime_error("Snapshot has mismatched permanent Variant generations");
+	}
+	for (int i = 0; i < snapshot.variants.size(); i++) {
+		if (perm_state.append_permanent(Variant(snapshot.variants[i])) < 0) {
+			throw std::runtime_error("Snapshot has more permanent Variants than the maximum references");
+		}
+		perm_state.generations[i] = snapshot.variant_generations[i];
+	}
+	for (int i = 0; i < snapshot.free_variant_slots.size(); i++) {
+		perm_state.free_slots.push_back(snapshot.free_variant_slots[i]);
+	}
+	for (int i = 0; i < snapshot.interned_names.size(); i++) {
+		this->intern_name(snapshot.interned_names[i]);
+	}
+	for (int i = 0; i < snapshot.properties.size(); i++) {
+		const Dictionary prop = snapshot.properties[i];
+		const Variant::Type type = Variant::Type(int(prop["type"]));
+		const gaddr_t address = prop["address"];
+		if (address != 0) {
+			this->add_property(prop["name"], type, address, prop["default"]);
+		} else {
+			this->add_property(prop["name"], type, gaddr_t(prop["setter"]), gaddr_t(prop["getter"]), prop["default"]);
+		}
+	}
+	// Public functions are normally registered by main(), which does not run here
+	if (this->m_program_data->functions.is_empty() && !snapshot.functions.is_empty()) {
+		this->m_program_data->set_public_api_functions(snapshot.functions.duplicate());
+	}
+	if constexpr (VERBOSE_SNAPSHOT) {
+		printf("Sandbox: Restored snapshot of %s\n", this->m_program_data->get_path().utf8().ptr());
+	}
+	return true;
+}
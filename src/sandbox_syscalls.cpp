@@ -19,6 +19,15 @@
 		machine.penalize(x); \
 	}
 
+// Engine objects, and user script Callables such as restriction callbacks, may only be used
+// on the main thread. System calls made from vmcall_parallel() worker threads are handed
+// over to the main thread, which runs the same handler while the worker waits.
+#define MAIN_THREAD_ONLY(handler) \
+	if (UNLIKELY(Sandbox::is_worker_thread())) { \
+		Sandbox::run_on_main_thread(machine, handler); \
+		return; \
+	}
+
 namespace riscv {
 extern std::unordered_map<std::string, std::function<uint64_t()>> global_singleton_list;
 
@@ -77,7 +86,29 @@ static inline Variant object_call(Sandbox &emu, godot::Object *obj, const Varian
 	return object_callp(obj, vargs.data(), argc + 1);
 }
 
+// Method and property names are passed either as a guest string, or as a null
+// pointer followed by a handle from ECALL_INTERN_NAME, which avoids interning
+// the name again on every call.
+static inline StringName guest_name(const Sandbox &emu, machine_t &machine, gaddr_t name, unsigned len) {
+	if (name == 0x0)
+		return emu.get_interned_name(len);
+	std::string_view view = machine.memory.memview(name, len + 1); // Include null terminator.
+	if (view.back() == '\0')
+		return StringName(view.data());
+	return String::utf8(view.data(), len);
+}
+
+APICALL(api_intern_name) {
+	auto [name] = machine.sysargs<std::string_view>();
+	Sandbox &emu = riscv::emu(machine);
+	PENALIZE(50'000);
+	SYS_TRACE("intern_name", String::utf8(name.data(), name.size()));
+
+	machine.set_result(emu.intern_name(String::utf8(name.data(), name.size())));
+}
+
 APICALL(api_print) {
+	MAIN_THREAD_ONLY(api_print);
 	auto [array, len] = machine.sysargs<gaddr_t, unsigned>();
 	Sandbox &emu = riscv::emu(machine);
 
@@ -97,6 +128,11 @@ APICALL(api_print) {
 	}
 }
 
+// Types that reach engine objects or user script when used
+static inline bool is_engine_type(int type) {
+	return type == Variant::OBJECT || type == Variant::CALLABLE || type == Variant::SIGNAL;
+}
+
 APICALL(api_vcall) {
 	auto [vp, method, mlen, args_ptr, args_size, vret_addr] = machine.sysargs<GuestVariant *, gaddr_t, unsigned, gaddr_t, gaddr_t, gaddr_t>();
 	Sandbox &emu = riscv::emu(machine);
@@ -108,13 +144,18 @@ APICALL(api_vcall) {
 	}
 
 	const GuestVariant *args = machine.memory.memarray<GuestVariant>(args_ptr, args_size);
-	StringName method_sn;
-	std::string_view method_sv = machine.memory.memview(method, mlen + 1); // Include null terminator.
-	if (method_sv.back() == '\0') {
-		method_sn = StringName(method_sv.data());
-	} else {
-		method_sn = String::utf8(method_sv.data(), mlen);
+	if (UNLIKELY(Sandbox::is_worker_thread())) {
+		// Objects, Callables and Signals run user script, also when passed to eg. Array::sort_custom()
+		bool main_thread = is_engine_type(vp->type);
+		for (size_t i = 0; i < args_size && !main_thread; i++) {
+			main_thread = is_engine_type(args[i].type);
+		}
+		if (main_thread) {
+			Sandbox::run_on_main_thread(machine, api_vcall);
+			return;
+		}
 	}
+	const StringName method_sn = guest_name(emu, machine, method, mlen);
 
 	Variant ret;
 
@@ -124,7 +165,7 @@ APICALL(api_vcall) {
 		// Check if the method is allowed.
 		if (!emu.is_allowed_method(obj, method_sn)) {
 			ERR_PRINT("Variant::call(): Method not allowed: " + method_sn);
-			throw std::runtime_error("Variant::call(): Method not allowed: " + std::string(method_sv));
+			throw std::runtime_error("Variant::call(): Method not allowed: " + std::string(String(method_sn).utf8().ptr()));
 		}
 
 		ret = object_call(emu, obj, method_sn, args, args_size);
@@ -163,6 +204,10 @@ APICALL(api_veval) {
 	auto &emu = riscv::emu(machine);
 	SYS_TRACE("veval", op, ap, bp, retp);
 
+	if (UNLIKELY(Sandbox::is_worker_thread()) && (is_engine_type(ap->type) || is_engine_type(bp->type))) {
+		Sandbox::run_on_main_thread(machine, api_veval);
+		return;
+	}
 	// Special case for comparing objects.
 	if (ap->type == Variant::OBJECT && bp->type == Variant::OBJECT) {
 		// Special case for equality, allowing invalid objects to be compared.
@@ -478,6 +523,25 @@ APICALL(api_vcreate) {
 	}
 }
 
+// Map the data of a packed array read-only into the guest, for PackedArray<T>::view()
+template <typename T>
+static void vfetch_view(Sandbox &emu, machine_t &machine, const T &array, gaddr_t gdata) {
+	const size_t bytes = array.size() * sizeof(*array.ptr());
+	gaddr_t address = 0;
+	if (bytes > 0) {
+		address = emu.view_array_internal(Variant(array), array.ptr(), bytes);
+		if (address == 0) {
+			throw std::runtime_error("vfetch: Failed to view packed array");
+		}
+	}
+	struct Buffer {
+		gaddr_t ptr;
+		gaddr_t size;
+	} *gview = machine.memory.memarray<Buffer>(gdata, 1);
+	gview->ptr = address;
+	gview->size = bytes;
+}
+
 APICALL(api_vfetch) {
 	auto [index, gdata, method] = machine.sysargs<unsigned, gaddr_t, int>();
 	Sandbox &emu = riscv::emu(machine);
@@ -486,7 +550,41 @@ APICALL(api_vfetch) {
 
 	// Find scoped Variant and copy data into gdata.
 	std::optional<const Variant *> opt = emu.get_scoped_variant(index);
-	if (opt.has_value()) {
+	if (opt.has_value() && method == 3) { // Read-only view, valid until the current call returns
+		const godot::Variant &var = *opt.value();
+		switch (var.get_type()) {
+			case Variant::PACKED_BYTE_ARRAY:
+				vfetch_view(emu, machine, var.operator PackedByteArray(), gdata);
+				break;
+			case Variant::PACKED_FLOAT32_ARRAY:
+				vfetch_view(emu, machine, var.operator PackedFloat32Array(), gdata);
+				break;
+			case Variant::PACKED_FLOAT64_ARRAY:
+				vfetch_view(emu, machine, var.operator PackedFloat64Array(), gdata);
+				break;
+			case Variant::PACKED_INT32_ARRAY:
+				vfetch_view(emu, machine, var.operator PackedInt32Array(), gdata);
+				break;
+			case Variant::PACKED_INT64_ARRAY:
+				vfetch_view(emu, machine, var.operator PackedInt64Array(), gdata);
+				break;
+			case Variant::PACKED_VECTOR2_ARRAY:
+				vfetch_view(emu, machine, var.operator PackedVector2Array(), gdata);
+				break;
+			case Variant::PACKED_VECTOR3_ARRAY:
+				vfetch_view(emu, machine, var.operator PackedVector3Array(), gdata);
+				break;
+			case Variant::PACKED_VECTOR4_ARRAY:
+				vfetch_view(emu, machine, var.operator PackedVector4Array(), gdata);
+				break;
+			case Variant::PACKED_COLOR_ARRAY:
+				vfetch_view(emu, machine, var.operator PackedColorArray(), gdata);
+				break;
+			default:
+				ERR_PRINT("vfetch: Cannot view Variant type");
+				throw std::runtime_error("vfetch: Cannot view Variant type");
+		}
+	} else if (opt.has_value()) {
 		const godot::Variant &var = *opt.value();
 		switch (var.get_type()) {
 			case Variant::STRING:
@@ -639,6 +737,22 @@ APICALL(api_vclone) {
 	}
 }
 
+APICALL(api_vfree) {
+	auto [vp] = machine.sysargs<GuestVariant *>();
+	Sandbox &emu = riscv::emu(machine);
+	SYS_TRACE("vfree", vp);
+
+	// Only Variants stored on the host side have a handle, other types keep their value in v.i
+	if (!vp->is_scoped_variant() || !Sandbox::is_permanent_variant(vp->v.i)) {
+		ERR_PRINT("vfree: Variant is not permanent");
+		throw std::runtime_error("vfree: Variant is not permanent");
+	}
+	// Free the permanent slot, which may be reused by the next permanent Variant
+	emu.free_permanent_variant(vp->v.i);
+	vp->type = Variant::NIL;
+	vp->v.i = 0;
+}
+
 APICALL(api_vstore) {
 	auto [vidx, type, gdata, gsize] = machine.sysargs<unsigned *, Variant::Type, gaddr_t, gaddr_t>();
 	auto &emu = riscv::emu(machine);
@@ -797,6 +911,7 @@ APICALL(api_vassign) {
 }
 
 APICALL(api_get_obj) {
+	MAIN_THREAD_ONLY(api_get_obj);
 	auto [name] = machine.sysargs<std::string>();
 	auto &emu = riscv::emu(machine);
 	PENALIZE(150'000);
@@ -838,6 +953,7 @@ APICALL(api_get_obj) {
 }
 
 APICALL(api_obj) {
+	MAIN_THREAD_ONLY(api_obj);
 	auto [op, addr, gvar] = machine.sysargs<int, uint64_t, gaddr_t>();
 	Sandbox &emu = riscv::emu(machine);
 	PENALIZE(250'000); // Costly Object operations.
@@ -917,10 +1033,11 @@ APICALL(api_obj) {
 }
 
 APICALL(api_obj_property_get) {
-	auto [addr, method, vret] = machine.sysargs<uint64_t, std::string_view, GuestVariant *>();
+	MAIN_THREAD_ONLY(api_obj_property_get);
+	auto [addr, g_name, g_name_len, vret] = machine.sysargs<uint64_t, gaddr_t, unsigned, GuestVariant *>();
 	auto &emu = riscv::emu(machine);
 	PENALIZE(150'000);
-	SYS_TRACE("obj_property_get", addr, method, vret);
+	SYS_TRACE("obj_property_get", addr, g_name, g_name_len, vret);
 
 	godot::Object *obj = nullptr;
 	if ((uint16_t)addr != addr) {
@@ -939,21 +1056,26 @@ APICALL(api_obj_property_get) {
 			throw std::runtime_error("api_obj_property_get: Variant is not scoped");
 		}
 	}
-	String prop_name = String::utf8(method.data(), method.size());
+	const StringName prop_name = guest_name(emu, machine, g_name, g_name_len);
 
 	if (UNLIKELY(!emu.is_allowed_property(obj, prop_name, false))) {
 		ERR_PRINT("Banned property accessed: " + prop_name);
-		throw std::runtime_error("Banned property accessed: " + std::string(prop_name.utf8()));
+		throw std::runtime_error("Banned property accessed: " + std::string(String(prop_name).utf8().ptr()));
 	}
 
 	vret->create(emu, obj->get(prop_name));
 }
 
 APICALL(api_obj_property_set) {
-	auto [addr, method, g_value] = machine.sysargs<uint64_t, std::string_view, const GuestVariant *>();
+	auto [addr, g_name, g_name_len, g_value] = machine.sysargs<uint64_t, gaddr_t, unsigned, const GuestVariant *>();
 	auto &emu = riscv::emu(machine);
+	// Writes are recorded on the calling thread when deferred writes are enabled
+	if (UNLIKELY(Sandbox::is_worker_thread()) && !emu.get_deferred_writes()) {
+		Sandbox::run_on_main_thread(machine, api_obj_property_set);
+		return;
+	}
 	PENALIZE(150'000);
-	SYS_TRACE("obj_property_set", addr, method, value);
+	SYS_TRACE("obj_property_set", addr, g_name, g_name_len, g_value);
 
 	godot::Object *obj = nullptr;
 	if ((uint16_t)addr != addr) {
@@ -972,17 +1094,22 @@ APICALL(api_obj_property_set) {
 			throw std::runtime_error("api_obj_property_get: Variant is not scoped");
 		}
 	}
-	String prop_name = String::utf8(method.data(), method.size());
+	const StringName prop_name = guest_name(emu, machine, g_name, g_name_len);
 
+	// Deferred writes are checked when they are applied, on the main thread
+	if (emu.get_deferred_writes()) {
+		emu.record_deferred_write(obj, Sandbox::DeferredCheck::PROPERTY, "set", 2, prop_name, g_value->toVariant(emu));
+		return;
+	}
 	if (UNLIKELY(!emu.is_allowed_property(obj, prop_name, true))) {
 		ERR_PRINT("Banned property set: " + prop_name);
-		throw std::runtime_error("Banned property set: " + std::string(prop_name.utf8()));
+		throw std::runtime_error("Banned property set: " + std::string(String(prop_name).utf8().ptr()));
 	}
-
 	obj->set(prop_name, g_value->toVariant(emu));
 }
 
 APICALL(api_obj_callp) {
+	MAIN_THREAD_ONLY(api_obj_callp);
 	auto [addr, g_method, g_method_len, deferred, vret_ptr, args_addr, args_size] = machine.sysargs<uint64_t, gaddr_t, unsigned, bool, gaddr_t, gaddr_t, unsigned>();
 	auto &emu = riscv::emu(machine);
 	PENALIZE(250'000); // Costly Object call operation.
@@ -995,20 +1122,12 @@ APICALL(api_obj_callp) {
 	}
 	const GuestVariant *g_args = machine.memory.memarray<GuestVariant>(args_addr, args_size);
 
-	Variant method;
-	std::string_view method_view = machine.memory.memview(g_method, g_method_len + 1);
-
-	// Check if the method is null-terminated.
-	if (method_view.back() == '\0') {
-		method = StringName(method_view.data(), false);
-	} else {
-		method = String::utf8(method_view.data(), method_view.size() - 1);
-	}
+	const Variant method = guest_name(emu, machine, g_method, g_method_len);
 
 	// Check for banned methods.
 	if (UNLIKELY(!emu.is_allowed_method(obj, method))) {
 		ERR_PRINT("Banned method called: " + method.operator String());
-		throw std::runtime_error("Banned method called: " + std::string(method_view));
+		throw std::runtime_error("Banned method called: " + std::string(method.operator String().utf8().ptr()));
 	}
 
 	if (!deferred) {
@@ -1042,7 +1161,59 @@ APICALL(api_obj_callp) {
 	}
 }
 
+APICALL(api_obj_method) {
+	MAIN_THREAD_ONLY(api_obj_method);
+	auto [op, addr] = machine.sysargs<int, uint64_t>();
+	auto &emu = riscv::emu(machine);
+
+	switch (Object_Method_Op(op)) {
+		case Object_Method_Op::RESOLVE: {
+			auto [unused_op, unused_addr, method] = machine.sysargs<int, uint64_t, std::string_view>();
+			PENALIZE(250'000); // Costly method lookup, done once per method.
+			SYS_TRACE("obj_method_resolve", addr, String::utf8(method.data(), method.size()));
+
+			godot::Object *obj = get_object_from_address(emu, addr);
+			machine.set_result(emu.resolve_method_handle(obj, String::utf8(method.data(), method.size())));
+			break;
+		}
+		case Object_Method_Op::CALL: {
+			auto [unused_op, unused_addr, handle, vret_ptr, args_addr, args_size] = machine.sysargs<int, uint64_t, unsigned, gaddr_t, gaddr_t, unsigned>();
+			PENALIZE(100'000); // The method name is already resolved.
+			SYS_TRACE("obj_method_call", addr, handle, vret_ptr, args_addr, args_size);
+
+			godot::Object *obj = get_object_from_address(emu, addr);
+			if (UNLIKELY(args_size > 8)) {
+				ERR_PRINT("Too many arguments to obj_method_call");
+				throw std::runtime_error("Too many arguments to obj_method_call");
+			}
+			const GuestVariant *g_args = machine.memory.memarray<GuestVariant>(args_addr, args_size);
+			const Variant method = emu.get_method_handle(obj, handle);
+
+			// Restrictions may depend on the object, so they are checked on every call.
+			if (UNLIKELY(!emu.is_allowed_method(obj, method))) {
+				ERR_PRINT("Banned method called: " + method.operator String());
+				throw std::runtime_error("Banned method called: " + std::string(method.operator String().utf8().ptr()));
+			}
+
+			Variant ret = object_call(emu, obj, method, g_args, args_size);
+			if (vret_ptr != 0) {
+				GuestVariant *vret = machine.memory.memarray<GuestVariant>(vret_ptr, 1);
+				vret->create(emu, std::move(ret));
+			}
+			break;
+		}
+		default:
+			ERR_PRINT("Invalid Object method operation");
+			throw std::runtime_error("Invalid Object method operation");
+	}
+}
+
 APICALL(api_get_node) {
+	if (UNLIKELY(Sandbox::is_worker_thread())) {
+		// The scene tree may only be accessed from the main thread
+		Sandbox::run_on_main_thread(machine, api_get_node);
+		return;
+	}
 	auto [addr, name] = machine.sysargs<uint64_t, std::string_view>();
 	Sandbox &emu = riscv::emu(machine);
 	PENALIZE(150'000);
@@ -1074,6 +1245,7 @@ APICALL(api_get_node) {
 }
 
 APICALL(api_node_create) {
+	MAIN_THREAD_ONLY(api_node_create);
 	auto [type, g_class_name, g_class_len, name] = machine.sysargs<Node_Create_Shortlist, gaddr_t, unsigned, std::string_view>();
 	Sandbox &emu = riscv::emu(machine);
 	PENALIZE(150'000);
@@ -1150,9 +1322,36 @@ APICALL(api_node_create) {
 	machine.set_result(uint64_t(uintptr_t(node)));
 }
 
+static bool is_deferrable_node_op(Node_Op op) {
+	switch (op) {
+		case Node_Op::QUEUE_FREE:
+		case Node_Op::ADD_CHILD:
+		case Node_Op::ADD_CHILD_DEFERRED:
+		case Node_Op::ADD_SIBLING:
+		case Node_Op::ADD_SIBLING_DEFERRED:
+		case Node_Op::MOVE_CHILD:
+		case Node_Op::REMOVE_CHILD:
+		case Node_Op::REMOVE_CHILD_DEFERRED:
+		case Node_Op::SET_NAME:
+		case Node_Op::REPARENT:
+		case Node_Op::ADD_TO_GROUP:
+		case Node_Op::REMOVE_FROM_GROUP:
+			return true;
+		default:
+			return false;
+	}
+}
+
 APICALL(api_node) {
 	auto [op, addr, gvar] = machine.sysargs<int, uint64_t, gaddr_t>();
 	Sandbox &emu = riscv::emu(machine);
+	// Writes are recorded on the calling thread when deferred writes are enabled,
+	// and their restrictions are checked when they are applied on the main thread
+	const bool deferred = emu.get_deferred_writes() && is_deferrable_node_op(Node_Op(op));
+	if (UNLIKELY(Sandbox::is_worker_thread()) && !deferred) {
+		Sandbox::run_on_main_thread(machine, api_node);
+		return;
+	}
 	PENALIZE(250'000); // Costly Node operations.
 	SYS_TRACE("node_op", op, addr, gvar);
 
@@ -1170,12 +1369,16 @@ APICALL(api_node) {
 			var->create(emu, node->get_name());
 		} break;
 		case Node_Op::SET_NAME: {
+			GuestVariant *var = machine.memory.memarray<GuestVariant>(gvar, 1);
+			if (deferred) {
+				emu.record_deferred_write(node, Sandbox::DeferredCheck::PROPERTY, "set", 2, "name", var->toVariant(emu));
+				break;
+			}
 			// Check if setting the name is allowed.
 			if (UNLIKELY(!emu.is_allowed_property(node, "name", true))) {
 				ERR_PRINT("Banned property set: name");
 				throw std::runtime_error("Banned property set: name");
 			}
-			GuestVariant *var = machine.memory.memarray<GuestVariant>(gvar, 1);
 			node->set_name(var->toVariant(emu));
 		} break;
 		case Node_Op::GET_PATH: {
@@ -1211,12 +1414,15 @@ APICALL(api_node) {
 				throw std::runtime_error("Cannot queue free the sandbox");
 			}
 			// Check if queue_free is an allowed method.
-			if (UNLIKELY(!emu.is_allowed_method(node, "queue_free"))) {
+			if (UNLIKELY(!deferred && !emu.is_allowed_method(node, "queue_free"))) {
 				ERR_PRINT("Banned method called: queue_free");
 				throw std::runtime_error("Banned method called: queue_free");
 			}
 			//emu.rem_scoped_object(node);
-			node->queue_free();
+			if (deferred)
+				emu.record_deferred_write(node, Sandbox::DeferredCheck::METHOD, "queue_free");
+			else
+				node->queue_free();
 			break;
 		case Node_Op::DUPLICATE: {
 			// Check if creating a new node of this type is allowed.
@@ -1251,13 +1457,15 @@ APICALL(api_node) {
 		case Node_Op::ADD_CHILD_DEFERRED:
 		case Node_Op::ADD_CHILD: {
 			// Check for banned methods.
-			if (UNLIKELY(!emu.is_allowed_method(node, "add_child"))) {
+			if (UNLIKELY(!deferred && !emu.is_allowed_method(node, "add_child"))) {
 				ERR_PRINT("Banned method called: add_child");
 				throw std::runtime_error("Banned method called: add_child");
 			}
 			GuestVariant *child = machine.memory.memarray<GuestVariant>(gvar, 1);
 			godot::Node *child_node = get_node_from_address(emu, child->v.i);
-			if (Node_Op(op) == Node_Op::ADD_CHILD_DEFERRED)
+			if (deferred)
+				emu.record_deferred_write(node, Sandbox::DeferredCheck::METHOD, "add_child", 1, child_node);
+			else if (Node_Op(op) == Node_Op::ADD_CHILD_DEFERRED)
 				node->call_deferred("add_child", child_node);
 			else
 				node->add_child(child_node);
@@ -1265,38 +1473,45 @@ APICALL(api_node) {
 		case Node_Op::ADD_SIBLING_DEFERRED:
 		case Node_Op::ADD_SIBLING: {
 			// Check for banned methods.
-			if (UNLIKELY(!emu.is_allowed_method(node, "add_sibling"))) {
+			if (UNLIKELY(!deferred && !emu.is_allowed_method(node, "add_sibling"))) {
 				ERR_PRINT("Banned method called: add_sibling");
 				throw std::runtime_error("Banned method called: add_sibling");
 			}
 			GuestVariant *sibling = machine.memory.memarray<GuestVariant>(gvar, 1);
 			godot::Node *sibling_node = get_node_from_address(emu, sibling->v.i);
-			if (Node_Op(op) == Node_Op::ADD_SIBLING_DEFERRED)
+			if (deferred)
+				emu.record_deferred_write(node, Sandbox::DeferredCheck::METHOD, "add_sibling", 1, sibling_node);
+			else if (Node_Op(op) == Node_Op::ADD_SIBLING_DEFERRED)
 				node->call_deferred("add_sibling", sibling_node);
 			else
 				node->add_sibling(sibling_node);
 		} break;
 		case Node_Op::MOVE_CHILD: {
 			// Check for banned methods.
-			if (UNLIKELY(!emu.is_allowed_method(node, "move_child"))) {
+			if (UNLIKELY(!deferred && !emu.is_allowed_method(node, "move_child"))) {
 				ERR_PRINT("Banned method called: move_child");
 				throw std::runtime_error("Banned method called: move_child");
 			}
 			GuestVariant *vars = machine.memory.memarray<GuestVariant>(gvar, 2);
 			godot::Node *child_node = get_node_from_address(emu, vars[0].v.i);
 			// TODO: Check if the child is actually a child of the node? Verify index?
-			node->move_child(child_node, vars[1].v.i);
+			if (deferred)
+				emu.record_deferred_write(node, Sandbox::DeferredCheck::METHOD, "move_child", 2, child_node, vars[1].v.i);
+			else
+				node->move_child(child_node, vars[1].v.i);
 		} break;
 		case Node_Op::REMOVE_CHILD_DEFERRED:
 		case Node_Op::REMOVE_CHILD: {
 			// Check for banned methods.
-			if (UNLIKELY(!emu.is_allowed_method(node, "remove_child"))) {
+			if (UNLIKELY(!deferred && !emu.is_allowed_method(node, "remove_child"))) {
 				ERR_PRINT("Banned method called: remove_child");
 				throw std::runtime_error("Banned method called: remove_child");
 			}
 			GuestVariant *child = machine.memory.memarray<GuestVariant>(gvar, 1);
 			godot::Node *child_node = get_node_from_address(emu, child->v.i);
-			if (Node_Op(op) == Node_Op::REMOVE_CHILD_DEFERRED)
+			if (deferred)
+				emu.record_deferred_write(node, Sandbox::DeferredCheck::METHOD, "remove_child", 1, child_node);
+			else if (Node_Op(op) == Node_Op::REMOVE_CHILD_DEFERRED)
 				node->call_deferred("remove_child", child_node);
 			else
 				node->remove_child(child_node);
@@ -1328,12 +1543,18 @@ APICALL(api_node) {
 		case Node_Op::ADD_TO_GROUP: {
 			// Reg 12: Group string pointer, Reg 13: Group string length.
 			std::string_view group = machine.memory.memview(gvar, machine.cpu.reg(13));
-			node->add_to_group(String::utf8(group.data(), group.size()));
+			if (deferred)
+				emu.record_deferred_write(node, Sandbox::DeferredCheck::NONE, "add_to_group", 1, String::utf8(group.data(), group.size()));
+			else
+				node->add_to_group(String::utf8(group.data(), group.size()));
 		} break;
 		case Node_Op::REMOVE_FROM_GROUP: {
 			// Reg 12: Group string pointer, Reg 13: Group string length.
 			std::string_view group = machine.memory.memview(gvar, machine.cpu.reg(13));
-			node->remove_from_group(String::utf8(group.data(), group.size()));
+			if (deferred)
+				emu.record_deferred_write(node, Sandbox::DeferredCheck::NONE, "remove_from_group", 1, String::utf8(group.data(), group.size()));
+			else
+				node->remove_from_group(String::utf8(group.data(), group.size()));
 		} break;
 		case Node_Op::IS_IN_GROUP: {
 			// Reg 12: Group string pointer, Reg 13: Group string length, Reg 14: Result bool pointer.
@@ -1354,14 +1575,17 @@ APICALL(api_node) {
 		} break;
 		case Node_Op::REPARENT: {
 			// Check for banned methods.
-			if (UNLIKELY(!emu.is_allowed_method(node, "reparent"))) {
+			if (UNLIKELY(!deferred && !emu.is_allowed_method(node, "reparent"))) {
 				ERR_PRINT("Banned method called: reparent");
 				throw std::runtime_error("Banned method called: reparent");
 			}
 			// Reg 12: New parent node address, Reg 13: Keep transform bool.
 			godot::Node *new_parent = get_node_from_address(emu, gvar);
 			bool keep_transform = machine.cpu.reg(13);
-			node->reparent(new_parent, keep_transform);
+			if (deferred)
+				emu.record_deferred_write(node, Sandbox::DeferredCheck::METHOD, "reparent", 2, new_parent, keep_transform);
+			else
+				node->reparent(new_parent, keep_transform);
 		} break;
 		case Node_Op::IS_INSIDE_TREE: {
 			// Reg 12: Result bool pointer.
@@ -1373,10 +1597,58 @@ APICALL(api_node) {
 	}
 }
 
+// Typed access to guest Variants for the common Node2D/Node3D operations,
+// which avoids constructing a godot::Variant for every get and set.
+static inline real_t guest_real(const GuestVariant *var) {
+	switch (var->type) {
+		case Variant::FLOAT:
+			return var->v.f;
+		case Variant::INT:
+			return var->v.i;
+		default:
+			ERR_PRINT("Expected a float Variant");
+			throw std::runtime_error("Expected a float Variant, got " + std::string(GuestVariant::type_name(var->type)));
+	}
+}
+static inline Vector2 guest_vector2(const GuestVariant *var) {
+	if (UNLIKELY(var->type != Variant::VECTOR2)) {
+		ERR_PRINT("Expected a Vector2 Variant");
+		throw std::runtime_error("Expected a Vector2 Variant, got " + std::string(GuestVariant::type_name(var->type)));
+	}
+	return Vector2(var->v.v2f[0], var->v.v2f[1]);
+}
+static inline Vector3 guest_vector3(const GuestVariant *var) {
+	if (UNLIKELY(var->type != Variant::VECTOR3)) {
+		ERR_PRINT("Expected a Vector3 Variant");
+		throw std::runtime_error("Expected a Vector3 Variant, got " + std::string(GuestVariant::type_name(var->type)));
+	}
+	return Vector3(var->v.v3f[0], var->v.v3f[1], var->v.v3f[2]);
+}
+static inline void set_guest_real(GuestVariant *var, double value) {
+	var->type = Variant::FLOAT;
+	var->v.f = value;
+}
+static inline void set_guest_vector2(GuestVariant *var, const Vector2 &value) {
+	var->type = Variant::VECTOR2;
+	var->v.v2f = { value.x, value.y };
+}
+static inline void set_guest_vector3(GuestVariant *var, const Vector3 &value) {
+	var->type = Variant::VECTOR3;
+	var->v.v3f = { value.x, value.y, value.z };
+}
+
 APICALL(api_node2d) {
 	// Node2D operation, Node2D address, and the variant to get/set the value.
 	auto [op, addr, gvar] = machine.sysargs<int, uint64_t, gaddr_t>();
 	Sandbox &emu = riscv::emu(machine);
+	// Setters are the odd operations, which are recorded when deferred writes are enabled
+	static const StringName setters[] = { "set_position", "set_rotation", "set_scale", "set_skew", "set_transform" };
+	const bool immediate_position = Node2D_Op(op) == Node2D_Op::SET_POSITION_IMMEDIATE;
+	const bool deferred = emu.get_deferred_writes() && (((op & 1) != 0 && unsigned(op >> 1) < std::size(setters)) || immediate_position);
+	if (UNLIKELY(Sandbox::is_worker_thread()) && !deferred) {
+		Sandbox::run_on_main_thread(machine, api_node2d);
+		return;
+	}
 	PENALIZE(100'000); // Costly Node2D operations.
 	SYS_TRACE("node2d_op", op, addr, gvar);
 
@@ -1392,30 +1664,37 @@ APICALL(api_node2d) {
 
 	// View the variant from the guest memory.
 	GuestVariant *var = machine.memory.memarray<GuestVariant>(gvar, 1);
+	if (deferred) {
+		emu.record_deferred_write(node2d, Sandbox::DeferredCheck::NONE, setters[immediate_position ? 0 : op >> 1], 1, var->toVariant(emu));
+		return;
+	}
 	switch (Node2D_Op(op)) {
 		case Node2D_Op::GET_POSITION:
-			var->set(emu, node2d->get_position());
+			set_guest_vector2(var, node2d->get_position());
 			break;
 		case Node2D_Op::SET_POSITION:
-			node2d->set_deferred("position", var->toVariant(emu));
+			node2d->set_deferred("position", guest_vector2(var));
+			break;
+		case Node2D_Op::SET_POSITION_IMMEDIATE:
+			node2d->set_position(guest_vector2(var));
 			break;
 		case Node2D_Op::GET_ROTATION:
-			var->set(emu, node2d->get_rotation());
+			set_guest_real(var, node2d->get_rotation());
 			break;
 		case Node2D_Op::SET_ROTATION:
-			node2d->set_rotation(var->toVariant(emu));
+			node2d->set_rotation(guest_real(var));
 			break;
 		case Node2D_Op::GET_SCALE:
-			var->set(emu, node2d->get_scale());
+			set_guest_vector2(var, node2d->get_scale());
 			break;
 		case Node2D_Op::SET_SCALE:
-			node2d->set_scale(var->toVariant(emu));
+			node2d->set_scale(guest_vector2(var));
 			break;
 		case Node2D_Op::GET_SKEW:
-			var->set(emu, node2d->get_skew());
+			set_guest_real(var, node2d->get_skew());
 			break;
 		case Node2D_Op::SET_SKEW:
-			node2d->set_skew(var->toVariant(emu));
+			node2d->set_skew(guest_real(var));
 			break;
 		case Node2D_Op::GET_TRANSFORM:
 			var->create(emu, node2d->get_transform());
@@ -1433,6 +1712,13 @@ APICALL(api_node3d) {
 	// Node3D operation, Node3D address, and the variant to get/set the value.
 	auto [op, addr, gvar] = machine.sysargs<int, uint64_t, gaddr_t>();
 	Sandbox &emu = riscv::emu(machine);
+	// Setters are the odd operations, which are recorded when deferred writes are enabled
+	static const StringName setters[] = { "set_position", "set_rotation", "set_scale", "set_transform", "set_quaternion" };
+	const bool deferred = emu.get_deferred_writes() && (op & 1) != 0 && unsigned(op >> 1) < std::size(setters);
+	if (UNLIKELY(Sandbox::is_worker_thread()) && !deferred) {
+		Sandbox::run_on_main_thread(machine, api_node3d);
+		return;
+	}
 	PENALIZE(100'000); // Costly Node3D operations.
 	SYS_TRACE("node3d_op", op, addr, gvar);
 
@@ -1448,24 +1734,28 @@ APICALL(api_node3d) {
 
 	// View the variant from the guest memory.
 	GuestVariant *var = machine.memory.memarray<GuestVariant>(gvar, 1);
+	if (deferred) {
+		emu.record_deferred_write(node3d, Sandbox::DeferredCheck::NONE, setters[op >> 1], 1, var->toVariant(emu));
+		return;
+	}
 	switch (Node3D_Op(op)) {
 		case Node3D_Op::GET_POSITION:
-			var->set(emu, node3d->get_position());
+			set_guest_vector3(var, node3d->get_position());
 			break;
 		case Node3D_Op::SET_POSITION:
-			node3d->set_position(var->toVariant(emu));
+			node3d->set_position(guest_vector3(var));
 			break;
 		case Node3D_Op::GET_ROTATION:
-			var->set(emu, node3d->get_rotation());
+			set_guest_vector3(var, node3d->get_rotation());
 			break;
 		case Node3D_Op::SET_ROTATION:
-			node3d->set_rotation(var->toVariant(emu));
+			node3d->set_rotation(guest_vector3(var));
 			break;
 		case Node3D_Op::GET_SCALE:
-			var->set(emu, node3d->get_scale());
+			set_guest_vector3(var, node3d->get_scale());
 			break;
 		case Node3D_Op::SET_SCALE:
-			node3d->set_scale(var->toVariant(emu));
+			node3d->set_scale(guest_vector3(var));
 			break;
 		case Node3D_Op::GET_TRANSFORM:
 			var->create(emu, node3d->get_transform());
@@ -1485,6 +1775,83 @@ APICALL(api_node3d) {
 	}
 }
 
+APICALL(api_node_transforms) {
+	auto [iop, g_nodes, g_transforms, count] = machine.sysargs<int, gaddr_t, gaddr_t, unsigned>();
+	Sandbox &emu = riscv::emu(machine);
+	const Node_Transforms_Op op = Node_Transforms_Op(iop);
+	const bool is_set = op == Node_Transforms_Op::SET_TRANSFORMS_2D || op == Node_Transforms_Op::SET_TRANSFORMS_3D;
+	const bool deferred = emu.get_deferred_writes() && is_set;
+	if (UNLIKELY(Sandbox::is_worker_thread()) && !deferred) {
+		Sandbox::run_on_main_thread(machine, api_node_transforms);
+		return;
+	}
+	PENALIZE(100'000 + 10'000 * uint64_t(count)); // One syscall, but many Node operations.
+	SYS_TRACE("node_transforms", int(op), g_nodes, g_transforms, count);
+
+	const uint64_t *nodes = machine.memory.memarray<uint64_t>(g_nodes, count);
+	switch (op) {
+		case Node_Transforms_Op::GET_TRANSFORMS_2D:
+		case Node_Transforms_Op::SET_TRANSFORMS_2D: {
+			real_t *t = machine.memory.memarray<real_t>(g_transforms, size_t(count) * 6);
+			for (unsigned i = 0; i < count; i++, t += 6) {
+				godot::Node2D *node2d = godot::Object::cast_to<godot::Node2D>(get_node_from_address(emu, nodes[i]));
+				if (UNLIKELY(node2d == nullptr)) {
+					ERR_PRINT("Node2D object is not a Node2D");
+					throw std::runtime_error("Node2D object is not a Node2D");
+				}
+				if (is_set) {
+					const Transform2D transform(t[0], t[1], t[2], t[3], t[4], t[5]);
+					if (deferred)
+						emu.record_deferred_write(node2d, Sandbox::DeferredCheck::NONE, "set_transform", 1, transform);
+					else
+						node2d->set_transform(transform);
+				} else {
+					const Transform2D transform = node2d->get_transform();
+					for (int c = 0; c < 3; c++) {
+						t[c * 2 + 0] = transform.columns[c].x;
+						t[c * 2 + 1] = transform.columns[c].y;
+					}
+				}
+			}
+			break;
+		}
+		case Node_Transforms_Op::GET_TRANSFORMS_3D:
+		case Node_Transforms_Op::SET_TRANSFORMS_3D: {
+			real_t *t = machine.memory.memarray<real_t>(g_transforms, size_t(count) * 12);
+			for (unsigned i = 0; i < count; i++, t += 12) {
+				godot::Node3D *node3d = godot::Object::cast_to<godot::Node3D>(get_node_from_address(emu, nodes[i]));
+				if (UNLIKELY(node3d == nullptr)) {
+					ERR_PRINT("Node3D object is not a Node3D");
+					throw std::runtime_error("Node3D object is not a Node3D");
+				}
+				if (is_set) {
+					const Transform3D transform(
+							Basis(t[0], t[1], t[2], t[3], t[4], t[5], t[6], t[7], t[8]),
+							Vector3(t[9], t[10], t[11]));
+					if (deferred)
+						emu.record_deferred_write(node3d, Sandbox::DeferredCheck::NONE, "set_transform", 1, transform);
+					else
+						node3d->set_transform(transform);
+				} else {
+					const Transform3D transform = node3d->get_transform();
+					for (int r = 0; r < 3; r++) {
+						t[r * 3 + 0] = transform.basis.rows[r].x;
+						t[r * 3 + 1] = transform.basis.rows[r].y;
+						t[r * 3 + 2] = transform.basis.rows[r].z;
+					}
+					t[9] = transform.origin.x;
+					t[10] = transform.origin.y;
+					t[11] = transform.origin.z;
+				}
+			}
+			break;
+		}
+		default:
+			ERR_PRINT("Invalid Node transforms operation");
+			throw std::runtime_error("Invalid Node transforms operation");
+	}
+}
+
 APICALL(api_throw) {
 	auto [type, msg, vaddr, vfunc] = machine.sysargs<std::string_view, std::string_view, gaddr_t, gaddr_t>();
 	SYS_TRACE("throw", String::utf8(type.data(), type.size()), String::utf8(msg.data(), msg.size()), vaddr);
@@ -1512,6 +1879,13 @@ APICALL(api_throw) {
 	}
 }
 
+// The number of references the guest holds to an element copied into a guest buffer
+static inline unsigned references_of(const Variant &value) {
+	GuestVariant gv;
+	gv.type = value.get_type();
+	return (gv.is_scoped_variant() || gv.type == Variant::OBJECT) ? 1 : 0;
+}
+
 APICALL(api_array_ops) {
 	auto [op, arr_idx, idx, vaddr] = machine.sysargs<Array_Op, unsigned, int, gaddr_t>();
 	Sandbox &emu = riscv::emu(machine);
@@ -1582,6 +1956,56 @@ APICALL(api_array_ops) {
 			vp->set(emu, result);
 			break;
 		}
+		case Array_Op::GET_RANGE: {
+			// Primitive elements are copied by value, complex elements become scoped references.
+			// The copy stops early when the call runs out of references.
+			const unsigned capacity = machine.cpu.reg(14); // A4
+			if (UNLIKELY(idx < 0 || idx > array.size())) {
+				ERR_PRINT("Array range out of bounds: " + itos(idx));
+				throw std::runtime_error("Array range out of bounds: " + std::to_string(idx));
+			}
+			const unsigned max_count = std::min<int64_t>(capacity, array.size() - idx);
+			PENALIZE(1'000 * uint64_t(max_count));
+			GuestVariant *vars = machine.memory.memarray<GuestVariant>(vaddr, max_count);
+			unsigned references = emu.get_free_references();
+			unsigned count = 0;
+			for (; count < max_count; count++) {
+				Variant value = array[idx + count];
+				const unsigned needed = references_of(value);
+				if (needed > references)
+					break;
+				references -= needed;
+				vars[count].create(emu, std::move(value));
+			}
+			machine.set_result(count);
+			break;
+		}
+		case Array_Op::SET_RANGE: {
+			const unsigned count = machine.cpu.reg(14); // A4
+			if (UNLIKELY(idx < 0 || int64_t(idx) + count > array.size())) {
+				ERR_PRINT("Array range out of bounds: " + itos(idx));
+				throw std::runtime_error("Array range out of bounds: " + std::to_string(idx));
+			}
+			PENALIZE(1'000 * uint64_t(count));
+			const GuestVariant *vars = machine.memory.memarray<GuestVariant>(vaddr, count);
+			for (unsigned i = 0; i < count; i++) {
+				array[idx + i] = vars[i].toVariant(emu);
+			}
+			machine.set_result(count);
+			break;
+		}
+		case Array_Op::APPEND_RANGE: {
+			const unsigned count = machine.cpu.reg(14); // A4
+			PENALIZE(1'000 * uint64_t(count));
+			const GuestVariant *vars = machine.memory.memarray<GuestVariant>(vaddr, count);
+			const int64_t start = array.size();
+			array.resize(start + count);
+			for (unsigned i = 0; i < count; i++) {
+				array[start + i] = vars[i].toVariant(emu);
+			}
+			machine.set_result(count);
+			break;
+		}
 		default:
 			ERR_PRINT("Invalid Array operation");
 			throw std::runtime_error("Invalid Array operation");
@@ -1644,6 +2068,19 @@ APICALL(api_dict_ops) {
 		throw std::runtime_error("Invalid Dictionary object");
 	}
 	godot::Dictionary dict = opt_dict.value()->operator Dictionary();
+	// Keys and values copied for chunked reads are stale once the guest writes to a Dictionary
+	Sandbox::CurrentState::DictionaryRange &range = emu.state().dictionary_range;
+	switch (op) {
+		case Dictionary_Op::SET:
+		case Dictionary_Op::ERASE:
+		case Dictionary_Op::CLEAR:
+		case Dictionary_Op::MERGE:
+		case Dictionary_Op::GET_OR_ADD:
+			range = Sandbox::CurrentState::DictionaryRange();
+			break;
+		default:
+			break;
+	}
 
 	switch (op) {
 		case Dictionary_Op::GET: {
@@ -1670,6 +2107,54 @@ APICALL(api_dict_ops) {
 			machine.set_result(dict.has(key->toVariant(emu)));
 			break;
 		}
+		case Dictionary_Op::GET_KEYS:
+		case Dictionary_Op::GET_VALUES:
+		case Dictionary_Op::GET_ITEMS: {
+			// Copy into a guest buffer: vkey is the buffer, vaddr is its capacity in elements,
+			// and A4 is the index of the first entry, like Array_Op::GET_RANGE.
+			// Primitive elements are copied by value, complex elements become scoped references.
+			// The copy stops early when the call runs out of references.
+			const gaddr_t capacity = vaddr;
+			const int64_t start = int64_t(machine.cpu.reg(14)); // A4
+			if (UNLIKELY(start < 0 || start > dict.size())) {
+				ERR_PRINT("Dictionary range out of bounds: " + itos(start));
+				throw std::runtime_error("Dictionary range out of bounds: " + std::to_string(start));
+			}
+			const bool items = op == Dictionary_Op::GET_ITEMS;
+			const int64_t max_count = std::min<int64_t>(dict.size() - start, items ? capacity / 2 : capacity);
+			PENALIZE(1'000 * uint64_t(max_count));
+			GuestVariant *vars = machine.memory.memarray<GuestVariant>(vkey, items ? max_count * 2 : max_count);
+			// Reading a Dictionary in chunks builds its keys and values only once
+			if (range.dictionary != opt_dict.value() || range.size != dict.size()) {
+				range = Sandbox::CurrentState::DictionaryRange{ opt_dict.value(), dict.size() };
+			}
+			if (op != Dictionary_Op::GET_VALUES && range.keys.size() != range.size)
+				range.keys = dict.keys();
+			if (op != Dictionary_Op::GET_KEYS && range.values.size() != range.size)
+				range.values = dict.values();
+			const Array &keys = range.keys;
+			const Array &values = range.values;
+			unsigned references = emu.get_free_references();
+			int64_t count = 0;
+			for (; count < max_count; count++) {
+				Variant key = op != Dictionary_Op::GET_VALUES ? keys[start + count] : Variant();
+				Variant value = op != Dictionary_Op::GET_KEYS ? values[start + count] : Variant();
+				const unsigned needed = references_of(key) + references_of(value);
+				if (needed > references)
+					break;
+				references -= needed;
+				if (op == Dictionary_Op::GET_KEYS) {
+					vars[count].create(emu, std::move(key));
+				} else if (op == Dictionary_Op::GET_VALUES) {
+					vars[count].create(emu, std::move(value));
+				} else {
+					vars[count * 2 + 0].create(emu, std::move(key));
+					vars[count * 2 + 1].create(emu, std::move(value));
+				}
+			}
+			machine.set_result(count);
+			break;
+		}
 		case Dictionary_Op::GET_SIZE:
 			machine.set_result(dict.size());
 			break;
@@ -1834,6 +2319,7 @@ APICALL(api_string_append) {
 }
 
 APICALL(api_timer_periodic) {
+	MAIN_THREAD_ONLY(api_timer_periodic);
 	auto [interval, oneshot, callback, capture, vret] = machine.sysargs<double, bool, gaddr_t, std::array<uint8_t, 32> *, GuestVariant *>();
 	Sandbox &emu = riscv::emu(machine);
 	PENALIZE(100'000); // Costly Timer node creation.
@@ -1887,6 +2373,7 @@ APICALL(api_callable_create) {
 }
 
 APICALL(api_load) {
+	MAIN_THREAD_ONLY(api_load);
 	auto [path, g_result] = machine.sysargs<std::string_view, GuestVariant *>();
 	Sandbox &emu = riscv::emu(machine);
 	const String godot_path = String::utf8(path.data(), path.size());
@@ -1950,8 +2437,10 @@ APICALL(api_sandbox_add) {
 			}
 			break;
 		}
-		case 1: {
+		case 1:
+		case 3: {
 			// Add a new sandboxed public API method. Name, address, description, return type and arguments.
+			// Method 3 is a function that returns its value directly in registers, of the given type.
 			struct GuestFunctionExtra {
 				gaddr_t desc;
 				gaddr_t desc_len;
@@ -1962,6 +2451,14 @@ APICALL(api_sandbox_add) {
 			};
 			auto [method, name, address, g_extra] = machine.sysargs<int, std::string_view, gaddr_t, GuestFunctionExtra *>();
 			SYS_TRACE("sandbox_add", "method", String::utf8(name.data(), name.size()));
+			Variant::Type unboxed_return = Variant::VARIANT_MAX;
+			if (method == 3) {
+				unboxed_return = Variant::Type(machine.cpu.reg(REG_ARG5));
+				if (!Sandbox::is_unboxed_return_type(unboxed_return)) {
+					ERR_PRINT("Invalid unboxed return type for public API function: " + itos(unboxed_return));
+					throw std::runtime_error("Invalid unboxed return type for public API function");
+				}
+			}
 			// Get the description, return type and arguments. We have a limited amount of registers,
 			// so we will use zero-terminated strings for the description and return type.
 			std::string_view description = machine.memory.memview(g_extra->desc, g_extra->desc_len);
@@ -1971,6 +2468,9 @@ APICALL(api_sandbox_add) {
 			if (Ref<ELFScript> program = emu.get_program(); program.is_valid()) {
 				Dictionary func = Sandbox::create_public_api_function(name, address, description, return_type, arguments);
 				if (func.size() > 0) {
+					if (unboxed_return != Variant::VARIANT_MAX) {
+						func["unboxed_return"] = unboxed_return;
+					}
 					if (program->functions.size() >= Sandbox::MAX_PUBLIC_FUNCTIONS) {
 						ERR_PRINT("Too many public functions in the Sandbox program");
 						throw std::runtime_error("Too many public functions in the Sandbox program");
@@ -1989,7 +2489,7 @@ APICALL(api_sandbox_add) {
 				}
 			}
 			// Cache the function name hash with the address for faster lookup.
-			emu.add_cached_address(String::utf8(name.data(), name.size()), address);
+			emu.add_cached_address(String::utf8(name.data(), name.size()), address, unboxed_return);
 		} break;
 		case 2: { // Set new exit address.
 			SYS_TRACE("sandbox_add", "exit", machine.cpu.reg(11));
@@ -2153,10 +2653,13 @@ void Sandbox::initialize_syscalls() {
 			{ ECALL_GET_OBJ, api_get_obj },
 			{ ECALL_OBJ, api_obj },
 			{ ECALL_OBJ_CALLP, api_obj_callp },
+			{ ECALL_OBJ_METHOD, api_obj_method },
+			{ ECALL_INTERN_NAME, api_intern_name },
 			{ ECALL_GET_NODE, api_get_node },
 			{ ECALL_NODE, api_node },
 			{ ECALL_NODE2D, api_node2d },
 			{ ECALL_NODE3D, api_node3d },
+			{ ECALL_NODE_TRANSFORMS, api_node_transforms },
 			{ ECALL_THROW, api_throw },
 			{ ECALL_IS_EDITOR, [](machine_t &machine) {
 				 machine.set_result(godot::Engine::get_singleton()->is_editor_hint());
@@ -2166,6 +2669,7 @@ void Sandbox::initialize_syscalls() {
 			{ ECALL_VFETCH, api_vfetch },
 			{ ECALL_VCLONE, api_vclone },
 			{ ECALL_VSTORE, api_vstore },
+			{ ECALL_VFREE, api_vfree },
 
 			{ ECALL_ARRAY_OPS, api_array_ops },
 			{ ECALL_ARRAY_AT, api_array_at },
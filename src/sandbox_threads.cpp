@@ -0,0 +1,215 @@
+#include "sandbox.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/core/object.hpp>
+#include <godot_cpp/variant/callable_method_pointer.hpp>
+#include <mutex>
+
+namespace {
+// A system call made by a worker thread, waiting to be handled on the main thread
+struct MainThreadCall {
+	machine_t *machine;
+	void (*handler)(machine_t &);
+	std::function<void()> function; // Used instead of the handler, if set
+	std::exception_ptr exception;
+	bool done = false;
+};
+struct ParallelCall {
+	std::vector<Sandbox *> sandboxes;
+	std::vector<gaddr_t> addresses;
+	// Each sandbox has its own copy of the arguments, as the guest may modify containers
+	std::vector<std::vector<Variant>> args;
+	std::vector<std::vector<const Variant *>> argptrs;
+	std::vector<Variant> results;
+};
+static std::mutex main_thread_mutex;
+static std::condition_variable main_thread_cv; // New calls for the main thread
+static std::condition_variable worker_cv; // Completed calls for the workers
+static std::vector<MainThreadCall *> main_thread_calls;
+// Only the main thread starts parallel calls, and only one at a time
+static ParallelCall *current_parallel_call = nullptr;
+
+static void wait_for_main_thread(MainThreadCall &call) {
+	{
+		std::lock_guard<std::mutex> lock(main_thread_mutex);
+		main_thread_calls.push_back(&call);
+	}
+	main_thread_cv.notify_one();
+	// The machine is paused in this system call until the main thread is done with it
+	std::unique_lock<std::mutex> lock(main_thread_mutex);
+	worker_cv.wait(lock, [&call] { return call.done; });
+	if (call.exception) {
+		std::rethrow_exception(call.exception);
+	}
+}
+} //namespace
+
+void Sandbox::run_on_main_thread(machine_t &machine, void (*handler)(machine_t &)) {
+	MainThreadCall call{ &machine, handler };
+	wait_for_main_thread(call);
+}
+
+void Sandbox::run_on_main_thread(std::function<void()> &&function) {
+	MainThreadCall call{ nullptr, nullptr, std::move(function) };
+	wait_for_main_thread(call);
+}
+
+void Sandbox::process_main_thread_calls() {
+	std::vector<MainThreadCall *> calls;
+	{
+		std::unique_lock<std::mutex> lock(main_thread_mutex);
+		main_thread_cv.wait_for(lock, std::chrono::milliseconds(1), [] { return !main_thread_calls.empty(); });
+		calls.swap(main_thread_calls);
+	}
+	if (calls.empty())
+		return;
+	for (MainThreadCall *call : calls) {
+		try {
+			if (call->function) {
+				call->function();
+			} else {
+				call->handler(*call->machine);
+			}
+		} catch (...) {
+			// Rethrown on the worker thread, where the guest exception is handled
+			call->exception = std::current_exception();
+		}
+	}
+	{
+		std::lock_guard<std::mutex> lock(main_thread_mutex);
+		for (MainThreadCall *call : calls) {
+			call->done = true;
+		}
+	}
+	worker_cv.notify_all();
+}
+
+void Sandbox::parallel_call_task(uint32_t index) {
+	ParallelCall &pc = *current_parallel_call;
+	t_worker_thread = true;
+	if (pc.addresses[index] != 0x0) {
+		const std::vector<const Variant *> &argptrs = pc.argptrs[index];
+		pc.results[index] = pc.sandboxes[index]->vmcall_internal(pc.addresses[index], argptrs.data(), argptrs.size());
+	}
+	t_worker_thread = false;
+}
+
+Array Sandbox::vmcall_parallel(const Array &sandboxes, const String &function, const Array &args) {
+	Array results;
+	if (is_worker_thread() || current_parallel_call != nullptr) {
+		ERR_PRINT("Sandbox: Parallel calls cannot be nested.");
+		return results;
+	}
+	if (args.size() > 16) {
+		ERR_PRINT("Sandbox: Too many arguments for VM function call");
+		return results;
+	}
+	ParallelCall pc;
+	pc.sandboxes.reserve(sandboxes.size());
+	pc.addresses.reserve(sandboxes.size());
+	const int64_t hash = function.hash();
+	for (int i = 0; i < sandboxes.size(); i++) {
+		Sandbox *sandbox = Object::cast_to<Sandbox>(sandboxes[i]);
+		if (sandbox == nullptr || sandbox->is_in_vmcall()) {
+			ERR_PRINT("Sandbox: Parallel calls require idle Sandbox instances.");
+			return results;
+		}
+		// A sandbox may only run on one thread at a time
+		if (std::find(pc.sandboxes.begin(), pc.sandboxes.end(), sandbox) != pc.sandboxes.end()) {
+			ERR_PRINT("Sandbox: The same Sandbox instance cannot be called in parallel with itself.");
+			return results;
+		}
+		const gaddr_t address = sandbox->cached_address_of(hash, function);
+		if (address == 0x0) {
+			ERR_PRINT("Function not found in the guest: " + function);
+		}
+		pc.sandboxes.push_back(sandbox);
+		pc.addresses.push_back(address);
+	}
+	// Arrays, Dictionaries and packed arrays are shared by reference, so they are deep copied
+	// for each sandbox. Otherwise guests running at the same time would write to the same container.
+	pc.args.resize(pc.sandboxes.size());
+	pc.argptrs.resize(pc.sandboxes.size());
+	for (size_t s = 0; s < pc.sandboxes.size(); s++) {
+		pc.args[s].reserve(args.size());
+		for (int i = 0; i < args.size(); i++) {
+			pc.args[s].push_back(args[i].duplicate(true));
+		}
+		for (const Variant &arg : pc.args[s]) {
+			pc.argptrs[s].push_back(&arg);
+		}
+	}
+	pc.results.resize(pc.sandboxes.size());
+
+	current_parallel_call = &pc;
+	WorkerThreadPool *pool = WorkerThreadPool::get_singleton();
+	const int64_t group_id = pool->add_group_task(callable_mp_static(&Sandbox::parallel_call_task), pc.sandboxes.size(), -1, true, "Sandbox::vmcall_parallel");
+	// Handle scene tree access from the workers until all calls are done
+	while (!pool->is_group_task_completed(group_id)) {
+		process_main_thread_calls();
+	}
+	pool->wait_for_group_task_completion(group_id);
+	current_parallel_call = nullptr;
+
+	results.resize(pc.results.size());
+	for (size_t i = 0; i < pc.results.size(); i++) {
+		results[i] = std::move(pc.results[i]);
+	}
+	return results;
+}
+
+void Sandbox::record_deferred_write(godot::Object *object, DeferredCheck check, const StringName &method, uint8_t argc, Variant &&arg0, Variant &&arg1) {
+	if (UNLIKELY(this->m_deferred_commands.size() >= MAX_DEFERRED_WRITES)) {
+		ERR_PRINT("Sandbox: Too many deferred writes, flush_deferred_writes() must be called.");
+		throw std::runtime_error("Too many deferred writes");
+	}
+	// Objects are recorded by ID, as they may be freed before the writes are applied
+	this->m_deferred_commands.push_back(DeferredCommand{ object->get_instance_id(), method, check, argc, { std::move(arg0), std::move(arg1) } });
+}
+
+int64_t Sandbox::flush_deferred_writes() {
+	if (is_worker_thread()) {
+		ERR_PRINT("Sandbox: Deferred writes must be flushed on the main thread.");
+		return 0;
+	}
+	// Writes may call back into this sandbox, which could record new writes
+	std::vector<DeferredCommand> commands;
+	commands.swap(this->m_deferred_commands);
+
+	int64_t applied = 0;
+	for (DeferredCommand &cmd : commands) {
+		godot::Object *obj = ObjectDB::get_instance(cmd.object_id);
+		if (obj == nullptr)
+			continue;
+		// Restrictions were not checked when the write was recorded on a worker thread
+		if (cmd.check == DeferredCheck::METHOD && !this->is_allowed_method(obj, cmd.method)) {
+			ERR_PRINT("Banned method called: " + String(cmd.method));
+			continue;
+		} else if (cmd.check == DeferredCheck::PROPERTY && !this->is_allowed_property(obj, cmd.args[0], true)) {
+			ERR_PRINT("Banned property set: " + String(cmd.args[0]));
+			continue;
+		}
+		switch (cmd.argc) {
+			case 0:
+				obj->call(cmd.method);
+				break;
+			case 1:
+				obj->call(cmd.method, cmd.args[0]);
+				break;
+			default:
+				obj->call(cmd.method, cmd.args[0], cmd.args[1]);
+				break;
+		}
+		applied++;
+	}
+	// Keep the capacity of the buffer for the next frame
+	commands.clear();
+	if (this->m_deferred_commands.empty()) {
+		this->m_deferred_commands.swap(commands);
+	}
+	return applied;
+}
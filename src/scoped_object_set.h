@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief A set of object addresses that are accessible during a single VM call.
+ *
+ * Open addressing with linear probing, sized to at least twice the maximum number
+ * of references, so that lookups and removals are O(1) on average. Slots carry the
+ * generation they were written in, which makes clearing the set between calls O(1).
+ */
+class ScopedObjectSet {
+public:
+	/// @brief Make room for at least the given number of objects.
+	/// @param max The maximum number of objects held at the same time.
+	void reserve(size_t max) {
+		size_t capacity = 16;
+		while (capacity < max * 2)
+			capacity <<= 1;
+		if (capacity > m_slots.size())
+			rehash(capacity);
+	}
+
+	bool contains(uintptr_t key) const noexcept {
+		if (m_size == 0)
+			return false;
+		const size_t mask = m_slots.size() - 1;
+		for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+			const Slot &slot = m_slots[i];
+			if (slot.generation != m_generation)
+				return false;
+			if (slot.key == key)
+				return true;
+		}
+	}
+
+	/// @brief Add an object to the set.
+	/// @return True if the object was added, false if it was already present.
+	bool insert(uintptr_t key) {
+		if ((m_size + m_tombstones + 1) * 2 > m_slots.size())
+			rehash(m_slots.empty() ? 16 : (m_size + 1) * 4 > m_slots.size() ? m_slots.size() * 2 : m_slots.size());
+		const size_t mask = m_slots.size() - 1;
+		for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+			Slot &slot = m_slots[i];
+			if (slot.generation != m_generation) {
+				slot = { key, m_generation };
+				m_size++;
+				return true;
+			}
+			if (slot.key == key)
+				return false;
+		}
+	}
+
+	void erase(uintptr_t key) noexcept {
+		if (m_size == 0)
+			return;
+		const size_t mask = m_slots.size() - 1;
+		for (size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+			Slot &slot = m_slots[i];
+			if (slot.generation != m_generation)
+				return;
+			if (slot.key == key) {
+				// Leave a tombstone, so that probing continues past this slot
+				slot.key = TOMBSTONE;
+				m_size--;
+				m_tombstones++;
+				return;
+			}
+		}
+	}
+
+	/// @brief Remove all objects, without touching the slots.
+	void clear() noexcept {
+		m_size = 0;
+		m_tombstones = 0;
+		if (++m_generation == 0) {
+			// The generation wrapped around, so stale slots could look valid
+			for (Slot &slot : m_slots)
+				slot.generation = 0;
+			m_generation = 1;
+		}
+	}
+
+	size_t size() const noexcept { return m_size; }
+	bool empty() const noexcept { return m_size == 0; }
+
+private:
+	static constexpr uintptr_t TOMBSTONE = ~uintptr_t(0);
+	struct Slot {
+		uintptr_t key = 0;
+		uint32_t generation = 0;
+	};
+
+	static size_t hash(uintptr_t key) noexcept {
+		// Objects are aligned, so mix the upper bits into the lower ones
+		uint64_t h = uint64_t(key) * 0x9E3779B97F4A7C15ull;
+		return size_t(h >> 32) ^ size_t(h);
+	}
+
+	void rehash(size_t capacity) {
+		std::vector<Slot> old = std::move(m_slots);
+		const uint32_t old_generation = m_generation;
+		m_slots.assign(capacity, Slot{});
+		m_generation = 1;
+		m_size = 0;
+		m_tombstones = 0;
+		for (const Slot &slot : old) {
+			if (slot.generation == old_generation && slot.key != TOMBSTONE)
+				insert(slot.key);
+		}
+	}
+
+	std::vector<Slot> m_slots;
+	size_t m_size = 0;
+	size_t m_tombstones = 0;
+	uint32_t m_generation = 1;
+};
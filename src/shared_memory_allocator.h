@@ -0,0 +1,79 @@
+#pragma once
+#include <cstdint>
+#include <iterator>
+#include <map>
+
+/**
+ * @brief Allocates guest address ranges for memory shared with the host.
+ *
+ * Freed ranges are kept in a free list ordered by address, and merged with their
+ * neighbours, so that sharing and unsharing arrays over and over reuses the same
+ * addresses instead of walking through the address space. Ranges freed at the end
+ * of the allocated space give it back entirely.
+ */
+class SharedMemoryAllocator {
+public:
+	explicit SharedMemoryAllocator(uint64_t base) : m_base(base), m_end(base) {}
+
+	/// @brief Allocate a range of addresses.
+	/// @param size The size of the range, a multiple of the page size.
+	/// @return The start of the range.
+	uint64_t allocate(uint64_t size) {
+		// First fit, which keeps allocations towards the start of the space
+		for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+			if (it->second >= size) {
+				const uint64_t address = it->first;
+				const uint64_t remaining = it->second - size;
+				m_free.erase(it);
+				if (remaining > 0)
+					m_free.emplace(address + size, remaining);
+				return address;
+			}
+		}
+		const uint64_t address = m_end;
+		m_end += size;
+		return address;
+	}
+
+	/// @brief Free a range of addresses from allocate().
+	/// @param address The start of the range.
+	/// @param size The size of the range, as it was allocated.
+	void free(uint64_t address, uint64_t size) {
+		auto next = m_free.lower_bound(address);
+		// Merge with the following free range
+		if (next != m_free.end() && address + size == next->first) {
+			size += next->second;
+			next = m_free.erase(next);
+		}
+		// Merge with the preceding free range
+		if (next != m_free.begin()) {
+			auto prev = std::prev(next);
+			if (prev->first + prev->second == address) {
+				address = prev->first;
+				size += prev->second;
+				m_free.erase(prev);
+			}
+		}
+		if (address + size == m_end) {
+			m_end = address;
+		} else {
+			m_free.emplace(address, size);
+		}
+	}
+
+	/// @brief Free all ranges.
+	void clear() {
+		m_free.clear();
+		m_end = m_base;
+	}
+
+	/// @brief The end of the allocated space, which is where the next new range starts.
+	uint64_t end() const noexcept { return m_end; }
+	/// @brief The number of free ranges below the end of the allocated space.
+	size_t free_ranges() const noexcept { return m_free.size(); }
+
+private:
+	std::map<uint64_t, uint64_t> m_free; // Start address -> size
+	const uint64_t m_base;
+	uint64_t m_end;
+};
@@ -0,0 +1,136 @@
+#include "../compile_scheduler.h"
+#include "../sandbox.h"
+
+#include <chrono>
+#include <climits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+// Lets a test wait for, or hold back, a job running on a worker thread
+struct Gate {
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool open = false;
+
+	void release() {
+		std::lock_guard<std::mutex> lock(mutex);
+		open = true;
+		cv.notify_all();
+	}
+	bool wait(std::chrono::milliseconds timeout = std::chrono::seconds(10)) {
+		std::unique_lock<std::mutex> lock(mutex);
+		return cv.wait_for(lock, timeout, [this] { return open; });
+	}
+};
+// Shared with the jobs, which may outlive a failed test
+struct TestState {
+	Gate started;
+	Gate blocker;
+	Gate done;
+	std::mutex mutex;
+	std::string order;
+
+	void add(char job) {
+		std::lock_guard<std::mutex> lock(mutex);
+		order += job;
+	}
+	std::string get_order() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return order;
+	}
+};
+} //namespace
+
+class CompileSchedulerTests {
+public:
+	static std::vector<std::string> run();
+};
+
+std::vector<std::string> CompileSchedulerTests::run() {
+	std::vector<std::string> failures;
+	auto expect = [&failures](bool condition, const char *what) {
+		if (!condition)
+			failures.push_back(what);
+	};
+
+	// One worker, so that the jobs run one at a time in a known order.
+	// Never destroyed, as the detached worker may outlive the test.
+	CompileScheduler &scheduler = *new CompileScheduler(1);
+	auto state = std::make_shared<TestState>();
+
+	// Hold the worker back, so that the next jobs wait in the queue
+	scheduler.submit(0, 0, nullptr, false, [state] {
+		state->started.release();
+		state->blocker.wait();
+	});
+	expect(state->started.wait(), "The first job did not start");
+
+	// Waiting jobs with the same key are merged, keeping the highest priority
+	expect(scheduler.submit(1, 0, nullptr, true, [state] { state->add('A'); }), "A job with a new key was not queued");
+	expect(!scheduler.submit(1, 5, nullptr, true, [state] { state->add('a'); }), "A waiting job with the same key was not merged");
+	scheduler.submit(2, 1, nullptr, true, [state] { state->add('B'); });
+	scheduler.submit(0, 10, nullptr, true, [state] { state->add('C'); });
+
+	// Deferred jobs wait until they are promoted
+	scheduler.defer(3, nullptr, true, [state] { state->add('D'); });
+	expect(scheduler.get_deferred_jobs() == 1, "The deferred job was not held back");
+	expect(!scheduler.promote(4, 0), "A job that was never deferred was promoted");
+	expect(scheduler.promote(3, 3), "The deferred job was not promoted");
+	expect(scheduler.get_deferred_jobs() == 0, "The promoted job was still deferred");
+
+	// Cancelled jobs are dropped, unless they are not cancellable
+	const int owner = 0;
+	scheduler.submit(5, 100, &owner, true, [state] { state->add('E'); });
+	scheduler.defer(6, &owner, true, [state] { state->add('F'); });
+	scheduler.submit(7, 2, &owner, false, [state] { state->add('G'); });
+	scheduler.cancel(&owner);
+	expect(scheduler.get_deferred_jobs() == 0, "The cancelled deferred job was kept");
+	expect(scheduler.get_queued_jobs() == 5, "The cancelled job was kept");
+
+	// Jobs shared by several owners are kept until all of them cancel
+	const int other = 0;
+	scheduler.defer(9, &owner, true, [state] { state->add('H'); });
+	expect(scheduler.add_owner(9, &other), "An owner was not added to the deferred job");
+	expect(!scheduler.add_owner(10, &other), "An owner was added to a job that does not exist");
+	scheduler.cancel(&owner);
+	expect(scheduler.get_deferred_jobs() == 1, "The shared job was cancelled by one of its owners");
+	scheduler.cancel(&other);
+	expect(scheduler.get_deferred_jobs() == 0, "The shared job was kept after all of its owners cancelled");
+
+	// The lowest priority job runs last
+	scheduler.submit(0, INT_MIN, nullptr, false, [state] { state->done.release(); });
+	state->blocker.release();
+	expect(state->done.wait(), "The queued jobs did not finish");
+	expect(state->get_order() == "CADGB", "The jobs did not run once each, in order of priority");
+
+	// A job with the key of a running job runs after it, and not at the same time
+	CompileScheduler &parallel = *new CompileScheduler(2);
+	auto running = std::make_shared<TestState>();
+	parallel.submit(8, 0, nullptr, false, [running] {
+		running->started.release();
+		running->blocker.wait();
+		running->add('1');
+	});
+	expect(running->started.wait(), "The running job did not start");
+	expect(parallel.submit(8, 0, nullptr, false, [running] {
+		running->add('2');
+		running->done.release();
+	}),
+			"A job with the key of a running job was not queued");
+	expect(!running->done.wait(std::chrono::milliseconds(100)), "Jobs with the same key ran at the same time");
+	running->blocker.release();
+	expect(running->done.wait(), "The job with the key of a running job did not run");
+	expect(running->get_order() == "12", "The jobs with the same key did not run in order");
+
+	return failures;
+}
+
+PackedStringArray Sandbox::test_compile_scheduler() {
+	PackedStringArray failures;
+	for (const std::string &failure : CompileSchedulerTests::run()) {
+		failures.push_back(String::utf8(failure.c_str(), failure.size()));
+	}
+	return failures;
+}
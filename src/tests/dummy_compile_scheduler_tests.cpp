@@ -0,0 +1,6 @@
+#include "../sandbox.h"
+
+PackedStringArray Sandbox::test_compile_scheduler() {
+	// Do nothing on actual platforms. This is a test function.
+	return PackedStringArray();
+}
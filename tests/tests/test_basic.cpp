@@ -7,6 +7,18 @@ struct MyException : public std::exception {
 	}
 };
 
+PUBLIC Variant test_batch_counter() {
+	static int64_t counter = 0;
+	return ++counter;
+}
+
+PUBLIC Variant test_batch_throw(double n) {
+	if (n == 0.0) {
+		asm volatile("unimp");
+	}
+	return n;
+}
+
 PUBLIC Variant test_exceptions() {
 #ifdef ZIG_COMPILER
 #warning "Zig does not support exceptions (yet)"
@@ -41,6 +53,12 @@ PUBLIC Variant test_permanent_storage(Variant key, Variant val) {
 	return fd;
 }
 
+static int64_t snapshot_counter = 0;
+PUBLIC Variant test_snapshot_counter(int64_t add) {
+	snapshot_counter += add;
+	return snapshot_counter;
+}
+
 static String ps = "Hello this is a permanent string";
 PUBLIC Variant test_permanent_string(String input) {
 	ps = input;
@@ -59,6 +77,34 @@ PUBLIC Variant test_permanent_dict(Dictionary input) {
 	return pd;
 }
 
+PUBLIC Variant test_free_permanent(String input) {
+	Variant v = input;
+	v.make_permanent();
+	const unsigned first = v.get_internal_index();
+	v.free_permanent();
+	// The freed slot is reused, with a new generation that invalidates the old handle
+	Variant w = input;
+	w.make_permanent();
+	const unsigned second = w.get_internal_index();
+	w.free_permanent();
+	return (first & 0xFFFF) == (second & 0xFFFF) && first != second;
+}
+
+static Variant free_victim;
+PUBLIC Variant test_free_permanent_int(String input) {
+	if (free_victim.get_type() == Variant::NIL) {
+		free_victim = input;
+		free_victim.make_permanent();
+	}
+	// An integer with the value of a permanent handle is not a handle
+	Variant i = int64_t(int32_t(free_victim.get_internal_index()));
+	i.free_permanent();
+	return false;
+}
+PUBLIC Variant test_free_victim() {
+	return free_victim;
+}
+
 PUBLIC Variant test_check_if_permanent(String test) {
 	if (test == "string") {
 		printf("Checking if string %d is permanent\n", ps.get_variant_index());
@@ -83,6 +129,112 @@ PUBLIC Variant test_recursive_calls(Node sandbox) {
 	return {};
 }
 
+PUBLIC Variant test_call_depth(Node sandbox, int remaining) {
+	if (remaining <= 0)
+		return sandbox("get_call_depth");
+	return sandbox("vmcall", "test_call_depth", sandbox, remaining - 1);
+}
+
+PUBLIC Variant test_deferred_writes(Node2D node, Vector2 position) {
+	node.set_position(position);
+	node.set_name("Deferred");
+	// Reads see the scene as it was before the writes are flushed
+	return node.get_name();
+}
+
+PUBLIC Variant test_node2d_set_position(Node2D node, Vector2 position, bool immediate) {
+	if (immediate)
+		node.set_position_immediate(position);
+	else
+		node.set_position(position);
+	return node.get_position();
+}
+
+PUBLIC Variant test_node2d_transforms(Node2D a, Node2D b) {
+	const Node2D nodes[] = { a, b };
+	// Translate both nodes by their index, keeping the axes
+	real_t transforms[2 * 6];
+	Node2D::get_transforms(nodes, transforms);
+	for (int i = 0; i < 2; i++) {
+		transforms[i * 6 + 4] += i + 1;
+		transforms[i * 6 + 5] += i + 1;
+	}
+	Node2D::set_transforms(nodes, transforms);
+	return b.get_position();
+}
+
+PUBLIC Variant test_node3d_transforms(Node3D a, Node3D b) {
+	const Node3D nodes[] = { a, b };
+	real_t transforms[2 * 12];
+	Node3D::get_transforms(nodes, transforms);
+	for (int i = 0; i < 2; i++) {
+		transforms[i * 12 + 9] += i + 1;
+		transforms[i * 12 + 10] += i + 1;
+		transforms[i * 12 + 11] += i + 1;
+	}
+	Node3D::set_transforms(nodes, transforms);
+	return b.get_position();
+}
+
+PUBLIC Variant test_method_handles(Node node) {
+	static MethodHandle set_name = node.resolve_method("set_name");
+	const MethodHandle get_name = node.resolve_method("get_name");
+	// The same method on the same class resolves to the same handle
+	if (node.resolve_method("get_name").id != get_name.id)
+		return "Fail";
+	node.call(set_name, "Handle");
+	return node.call(get_name);
+}
+
+PUBLIC Variant test_method_handle_class(Node node, Object other) {
+	// Handles only work on objects of the class they were resolved on
+	const MethodHandle get_name = node.resolve_method("get_name");
+	return other.call(get_name);
+}
+
+PUBLIC Variant test_interned_names(Node node) {
+	static const InternedName set_name("set_name");
+	static const InternedName name("name");
+	if (InternedName("set_name").id != set_name.id)
+		return "Fail";
+	node.voidcall(set_name, "Interned");
+	if (node.get(name) == "Interned")
+		node.set(name, "Interned 2");
+	return node.call(InternedName("get_name"));
+}
+
+PUBLIC Variant test_array_ranges(Array array) {
+	// Double every element, using a fixed-size buffer
+	Variant buffer[4];
+	for (int i = 0; i < array.size(); i += 4) {
+		const unsigned count = array.get_range(i, buffer);
+		for (unsigned j = 0; j < count; j++)
+			buffer[j] = int64_t(buffer[j]) * 2;
+		array.set_range(i, std::span<const Variant>(buffer, count));
+	}
+	const Variant tail[] = { "tail", Array::Create() };
+	array.append_range(tail);
+	return array;
+}
+
+PUBLIC Variant test_dictionary_items(Dictionary dict) {
+	// Swap keys and values, two entries at a time
+	Variant items[4];
+	Dictionary result = Dictionary::Create();
+	for (int i = 0; i < dict.size(); i += 2) {
+		const unsigned count = dict.get_items(i, items);
+		for (unsigned j = 0; j < count; j++)
+			result[items[j * 2 + 1]] = items[j * 2];
+	}
+	return result;
+}
+
+PUBLIC Variant test_dictionary_keys_limit(Dictionary dict) {
+	// Complex keys take references, so the copy stops before running out of them
+	Variant keys[256];
+	return dict.get_keys(0, keys);
+}
+
 PUBLIC Variant public_function() {
 	return "Hello from the other side";
 }
@@ -488,3 +640,25 @@ PUBLIC Variant test_many_unboxed_arguments2(int a1, int a2, int a3, int a4, int
 PUBLIC Variant get_tree_base_parent() {
 	return get_parent();
 }
+
+// Public API functions that return their value directly in registers
+static int64_t test_unboxed_return_int(Variant a, Variant b) {
+	return int64_t(a) + int64_t(b);
+}
+static double test_unboxed_return_float(Variant a) {
+	return double(a) * 2.0;
+}
+static Vector2 test_unboxed_return_vec2(Variant x, Variant y) {
+	return Vector2(x, y);
+}
+static Color test_unboxed_return_color(Variant r) {
+	return Color(r, 0.5f, 0.25f, 1.0f);
+}
+static struct UnboxedReturnFunctions {
+	UnboxedReturnFunctions() {
+		ADD_API_FUNCTION(test_unboxed_return_int, "int", "int a, int b");
+		ADD_API_FUNCTION(test_unboxed_return_float, "float", "float a");
+		ADD_API_FUNCTION(test_unboxed_return_vec2, "Vector2", "float x, float y");
+		ADD_API_FUNCTION(test_unboxed_return_color, "Color", "float r");
+	}
+} unboxed_return_functions;
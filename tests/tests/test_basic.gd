@@ -127,6 +127,134 @@ func test_binary_translation():
 	assert_false(str.is_empty(), "Binary translation is not empty")
 	#print(str)
 
+	# A smaller instruction budget produces less code
+	var budgeted : String = s.emit_binary_translation(false, false, {"instruction_budget": 100})
+	assert_false(budgeted.is_empty(), "Budgeted binary translation is not empty")
+	assert_lt(budgeted.length(), str.length(), "Budgeted binary translation is smaller")
+	var cached : String = s.emit_binary_translation(false, false, {"register_caching": true, "instruction_budget": 0})
+	assert_false(cached.is_empty(), "Binary translation with register caching is not empty")
+	# Unknown options are rejected
+	assert_true(s.emit_binary_translation(false, false, {"include": ["main"]}).is_empty(), "Unknown option is rejected")
+
+	s.queue_free()
+
+
+func test_binary_translation_bundle():
+	# Bundling needs a host C compiler
+	if OS.execute("cc", ["--version"]) != 0:
+		return
+	# Translations registered by a library stay for the rest of the process. They are matched
+	# to programs by their contents, so the test uses programs that no other test loads,
+	# and whose execute segments have never been built.
+	var test_elf : PackedByteArray = Sandbox_TestsTests.get_content().duplicate()
+	test_elf.append_array(PackedByteArray([0xB, 0x0, 0x0, 0x1]))
+	var compiler = Sandbox.new()
+	compiler.set_program(Sandbox_TestsTests)
+	var gdscript_elf : PackedByteArray = compiler.vmcall("compile_to_elf", "func bundle_add(x : int, y : int):\n\treturn x + y\n")
+	compiler.queue_free()
+	assert_false(gdscript_elf.is_empty(), "Compiled the second program")
+	gdscript_elf.append_array(PackedByteArray([0xB, 0x0, 0x0, 0x2]))
+	var programs := PackedStringArray(["user://bundle_test_a.elf", "user://bundle_test_b.elf"])
+	for i in programs.size():
+		var fa = FileAccess.open(programs[i], FileAccess.WRITE)
+		fa.store_buffer(test_elf if i == 0 else gdscript_elf)
+		fa.close()
+
+	# Both programs are linked into one library, with a single registration function
+	assert_true(Sandbox.try_compile_binary_translation_bundle("res://bundle_test", "cc", "", false, false, {}, programs), "Compiled the bundle")
+	var library : String = "res://bundle_test." + ("dll" if OS.get_name() == "Windows" else "dylib" if OS.get_name() == "macOS" else "so")
+	assert_true(Sandbox.load_binary_translation(library, true), "Loaded the bundle")
+
+	# Without the JIT, only the library can have translated the programs
+	var jit_enabled : bool = Sandbox.is_jit_enabled()
+	Sandbox.set_jit_enabled(false)
+	var s = Sandbox.new()
+	s.load_buffer(test_elf)
+	var g = Sandbox.new()
+	g.load_buffer(gdscript_elf)
+	Sandbox.set_jit_enabled(jit_enabled)
+	assert_true(s.is_binary_translated() and not s.is_jit(), "The test program is translated by the bundle")
+	assert_true(g.is_binary_translated() and not g.is_jit(), "The GDScript program is translated by the bundle")
+	assert_eq(s.vmcall("test_ping_pong", 123), 123)
+	assert_eq(g.vmcall("bundle_add", 2, 3), 5)
+	assert_eq(s.get_exceptions() + g.get_exceptions(), 0)
+
+	s.queue_free()
+	g.queue_free()
+	for program in programs:
+		DirAccess.remove_absolute(program)
+	DirAccess.remove_absolute(ProjectSettings.globalize_path(library))
+
+
+func test_tiered_binary_translation():
+	if not Sandbox.has_feature_jit() or not Sandbox.is_jit_enabled():
+		return
+	# A program that has not been compiled yet, so that its compilation is deferred
+	var elf : PackedByteArray = Sandbox_TestsTests.get_content().duplicate()
+	elf.append_array(PackedByteArray([0, 0, 0, 0]))
+	var deferred : int = Sandbox.get_background_compilations()["deferred"]
+	var first = Sandbox.new()
+	first.set_binary_translation_tier_threshold(4)
+	assert_eq(first.get_binary_translation_tier_threshold(), 4, "Tier threshold was set")
+	first.load_buffer(elf)
+	assert_eq(Sandbox.get_background_compilations()["deferred"], deferred + 1, "The compilation was deferred")
+
+	# Another load of the same program shares the execute segment, and so the deferred compilation
+	var parent = Sandbox.new()
+	parent.set_binary_translation_tier_threshold(4)
+	parent.load_buffer(elf)
+	assert_eq(Sandbox.get_background_compilations()["deferred"], deferred + 1, "The compilation was shared")
+	# Freeing the sandbox that deferred the compilation keeps it for the others
+	first.free()
+	assert_eq(Sandbox.get_background_compilations()["deferred"], deferred + 1, "The shared compilation was kept")
+
+	# Forks count their calls towards the deferred compilation of the program
+	var fork = Sandbox.new()
+	assert_true(fork.fork_from(parent), "Forked from the tiered sandbox")
+	for i in range(3):
+		assert_eq(fork.vmcall("test_ping_pong", i), i)
+	assert_eq(Sandbox.get_background_compilations()["deferred"], deferred + 1, "Not promoted before the threshold")
+	assert_eq(fork.vmcall("test_ping_pong", 3), 3)
+	assert_eq(Sandbox.get_background_compilations()["deferred"], deferred, "Promoted by the calls of the fork")
+
+	fork.queue_free()
+	parent.queue_free()
+
+
+func test_compile_scheduler():
+	# Merging, priorities, deferred jobs, cancellation and jobs with the key of a running job
+	assert_eq_deep(Sandbox.test_compile_scheduler(), PackedStringArray())
+
+
+func test_jit_cache_entries():
+	var s = Sandbox.new()
+	var elf : PackedByteArray = Sandbox_TestsTests.get_content()
+	var path : String = s.get_jit_cache_path(elf)
+	if not Sandbox.has_feature_jit() or path.is_empty():
+		s.queue_free()
+		return
+
+	# The same program with the same settings hits the same entry
+	var s2 = Sandbox.new()
+	assert_eq(s2.get_jit_cache_path(elf), path, "Same program and settings hit the same entry")
+	s2.queue_free()
+
+	# A different program misses
+	var other : PackedByteArray = elf.duplicate()
+	other.append(0)
+	assert_ne(s.get_jit_cache_path(other), path, "A different program misses")
+
+	# Changing the translation settings invalidates the entry
+	var instructions_max : int = s.get_instructions_max()
+	s.set_instructions_max(instructions_max + 1)
+	assert_ne(s.get_jit_cache_path(elf), path, "A different instruction limit misses")
+	s.set_instructions_max(0)
+	assert_ne(s.get_jit_cache_path(elf), path, "No instruction limit misses")
+	s.set_instructions_max(instructions_max)
+	assert_eq(s.get_jit_cache_path(elf), path, "The original settings hit again")
+	s.set_binary_translation_register_caching(not s.get_binary_translation_register_caching())
+	assert_ne(s.get_jit_cache_path(elf), path, "Different register caching misses")
+
 	s.queue_free()
 
 
@@ -616,6 +744,55 @@ func test_static_storage():
 	assert_eq_deep(pd, {"key": "value"})
 	assert_true(s.vmcall("test_check_if_permanent", "dict"), "Permanent dictionary is permanent")
 
+	exceptions = s.get_exceptions()
+	assert_true(s.vmcall("test_free_permanent", "Hello"), "Freed permanent slot is reused")
+	assert_eq(s.get_exceptions(), exceptions, "No exceptions thrown")
+
+	# Permanent Variants must not move, so the maximum references can no longer be raised
+	var max_refs : int = s.get_max_refs()
+	s.set_max_refs(max_refs * 2)
+	assert_eq(s.get_max_refs(), max_refs, "Max references not raised with permanent Variants")
+	assert_eq(s.vmcall("test_free_permanent", "Hello"), true, "Permanent Variants still valid")
+
+	# Only Variants with handles can be freed, even if their value looks like a handle
+	assert_null(s.vmcall("test_free_permanent_int", "Victim"))
+	assert_eq(s.get_exceptions(), exceptions + 1, "Freeing an integer throws")
+	assert_eq(s.vmcall("test_free_victim"), "Victim", "The permanent Variant was not freed")
+
+	s.queue_free()
+
+func test_snapshots():
+	var s : Sandbox = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+	assert_eq(s.vmcall("test_snapshot_counter", 40), 40)
+	assert_eq_deep(s.vmcall("test_permanent_storage", "key", "value"), {"key": "value"})
+
+	# Snapshots are only saved on request
+	var path : String = "user://test_snapshots.snapshot"
+	assert_eq(s.save_snapshot(path), OK)
+	s.queue_free()
+
+	# Without a loaded snapshot, the program starts from main()
+	s = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+	assert_eq(s.vmcall("test_snapshot_counter", 2), 2)
+	s.queue_free()
+
+	# Restoring the snapshot brings back guest globals and permanent Variants
+	assert_true(Sandbox_TestsTests.load_snapshot(path), "Snapshot matches the program")
+	s = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+	assert_eq(s.vmcall("test_snapshot_counter", 2), 42)
+	assert_eq_deep(s.vmcall("test_permanent_storage", "other", "value"), {"key": "value", "other": "value"})
+	assert_eq(s.get_exceptions(), 0)
+	s.queue_free()
+
+	# Loading a missing snapshot drops the previous one
+	DirAccess.remove_absolute(path)
+	assert_false(Sandbox_TestsTests.load_snapshot(path), "Snapshot was removed")
+	s = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+	assert_eq(s.vmcall("test_snapshot_counter", 2), 2)
 	s.queue_free()
 
 func callable_function():
@@ -636,3 +813,274 @@ func test_object_properties():
 	assert_eq(s.vmcall("test_property_proxy"), "TestOK", "PropertyProxy works")
 
 	s.queue_free()
+
+func test_call_sites():
+	var s : Sandbox = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+
+	var int_site = s.create_call_site("test_int", PackedInt32Array([TYPE_INT]), TYPE_INT)
+	assert_true(int_site.is_valid(), "Call site for test_int is valid")
+	assert_eq(int_site.call(1234), 1234)
+	assert_eq(int_site.call(-1), -1)
+
+	var vec2_site = s.create_call_site("test_vec2", PackedInt32Array([TYPE_VECTOR2]), TYPE_VECTOR2)
+	assert_eq(vec2_site.call(Vector2(1, 2)), Vector2(1, 2))
+
+	var string_site = s.create_call_site("test_string", PackedInt32Array([TYPE_STRING]), TYPE_STRING)
+	assert_eq(string_site.call("Hello"), "Hello")
+
+	# Unknown functions do not produce a call site
+	assert_null(s.create_call_site("no_such_function", PackedInt32Array()))
+
+	# Call sites are bound to the program they were created for
+	s.load_buffer(Sandbox_TestsTests.get_content())
+	assert_false(int_site.is_valid(), "Call site is invalid after loading a program")
+	assert_null(int_site.call(1234), "Call site does not call into another program")
+	int_site = s.create_call_site("test_int", PackedInt32Array([TYPE_INT]), TYPE_INT)
+	assert_eq(int_site.call(1234), 1234)
+	s.reset()
+	assert_false(int_site.is_valid(), "Call site is invalid after a reset")
+
+	s.queue_free()
+
+func test_vmcall_batch():
+	var s : Sandbox = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+
+	var calls_made = s.get_calls_made()
+	var results = s.vmcall_batch("test_int", [[1], [2], [3]])
+	assert_eq_deep(results, [1, 2, 3])
+	assert_eq(s.get_calls_made(), calls_made + 3)
+
+	var packed = s.vmcall_batch_packed("test_float", PackedFloat64Array([1.5, 2.5, 3.5]))
+	assert_eq_deep(packed, PackedFloat64Array([1.5, 2.5, 3.5]))
+
+	# Functions without arguments are batched by giving the number of calls
+	packed = s.vmcall_batch_packed("test_batch_counter", PackedFloat64Array(), 0, 3)
+	assert_eq_deep(packed, PackedFloat64Array([1, 2, 3]))
+	assert_eq_deep(s.vmcall_batch_packed("test_batch_counter", PackedFloat64Array(), 0), PackedFloat64Array())
+	assert_eq(s.get_exceptions(), 0)
+
+	# Invalid arguments are host errors, and not guest exceptions
+	calls_made = s.get_calls_made()
+	assert_eq_deep(s.vmcall_batch("test_int", [[1], 2]), [])
+	var too_many : Array = []
+	too_many.resize(17)
+	assert_eq_deep(s.vmcall_batch("test_int", [[1], too_many]), [])
+	assert_eq(s.get_calls_made(), calls_made)
+	assert_eq(s.get_exceptions(), 0)
+
+	# An exception ends the batch, returning the results before it
+	calls_made = s.get_calls_made()
+	assert_eq_deep(s.vmcall_batch("test_batch_throw", [[1.0], [2.0], [0.0], [3.0]]), [1.0, 2.0])
+	assert_eq(s.get_calls_made(), calls_made + 3)
+	assert_eq(s.get_exceptions(), 1)
+	calls_made = s.get_calls_made()
+	packed = s.vmcall_batch_packed("test_batch_throw", PackedFloat64Array([1, 0, 2]))
+	assert_eq_deep(packed, PackedFloat64Array([1]))
+	assert_eq(s.get_calls_made(), calls_made + 2)
+	assert_eq(s.get_exceptions(), 2)
+
+	s.queue_free()
+
+func test_unboxed_return_values():
+	var s : Sandbox = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+
+	assert_eq(s.vmcall("test_unboxed_return_int", 40, 2), 42)
+	assert_eq(s.vmcall("test_unboxed_return_float", 1.25), 2.5)
+	assert_eq(s.vmcall("test_unboxed_return_vec2", 1.0, 2.0), Vector2(1, 2))
+	assert_eq(s.vmcall("test_unboxed_return_color", 1.0), Color(1.0, 0.5, 0.25, 1.0))
+	# Batches decode the registers after each call
+	assert_eq_deep(s.vmcall_batch("test_unboxed_return_int", [[1, 2], [3, 4]]), [3, 7])
+
+	s.queue_free()
+
+func test_deferred_writes():
+	var s : Sandbox = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+	var n2d : Node2D = Node2D.new()
+	n2d.name = "Node2D"
+	s.deferred_writes = true
+
+	# Writes are recorded, not applied, until they are flushed
+	assert_eq(s.vmcall("test_deferred_writes", n2d, Vector2(1, 2)), "Node2D")
+	assert_eq(s.get_exceptions(), 0)
+	assert_eq(s.get_deferred_write_count(), 2)
+	assert_eq(n2d.position, Vector2(0, 0))
+	assert_eq(n2d.name, "Node2D")
+
+	assert_eq(s.flush_deferred_writes(), 2)
+	assert_eq(s.get_deferred_write_count(), 0)
+	assert_eq(n2d.position, Vector2(1, 2))
+	assert_eq(n2d.name, "Deferred")
+
+	# Writes to freed objects are skipped
+	s.vmcall("test_deferred_writes", n2d, Vector2(3, 4))
+	n2d.free()
+	assert_eq(s.flush_deferred_writes(), 0)
+
+	# Restrictions are checked when the writes are applied, dropping banned writes
+	n2d = Node2D.new()
+	n2d.name = "Node2D"
+	s.set_property_allowed_callback(func(_sandbox, _obj, property, is_set): return property != "name" or not is_set)
+	assert_eq(s.vmcall("test_deferred_writes", n2d, Vector2(7, 8)), "Node2D")
+	assert_eq(s.get_exceptions(), 0)
+	assert_eq(s.get_deferred_write_count(), 2)
+	assert_eq(s.flush_deferred_writes(), 1)
+	assert_eq(n2d.position, Vector2(7, 8))
+	assert_eq(n2d.name, "Node2D")
+	n2d.free()
+	s.set_property_allowed_callback(Callable())
+
+	# Without deferred writes, they are applied immediately
+	s.deferred_writes = false
+	n2d = Node2D.new()
+	assert_eq(s.vmcall("test_deferred_writes", n2d, Vector2(5, 6)), "Deferred")
+	assert_eq(n2d.name, "Deferred")
+	n2d.queue_free()
+	s.queue_free()
+
+
+func test_node_transforms():
+	var s : Sandbox = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+
+	var a : Node2D = Node2D.new()
+	var b : Node2D = Node2D.new()
+	b.position = Vector2(10, 20)
+	b.rotation = 0.5
+	assert_eq(s.vmcall("test_node2d_transforms", a, b), Vector2(12, 22))
+	assert_eq(s.get_exceptions(), 0)
+	assert_eq(a.position, Vector2(1, 1))
+	assert_almost_eq(b.rotation, 0.5, 0.0001)
+
+	var c : Node3D = Node3D.new()
+	var d : Node3D = Node3D.new()
+	d.position = Vector3(10, 20, 30)
+	d.scale = Vector3(2, 2, 2)
+	assert_eq(s.vmcall("test_node3d_transforms", c, d), Vector3(12, 22, 32))
+	assert_eq(s.get_exceptions(), 0)
+	assert_eq(c.position, Vector3(1, 1, 1))
+	assert_eq(d.scale, Vector3(2, 2, 2))
+
+	# Typed setters are applied immediately, except for the position which has its own immediate setter
+	assert_eq(s.vmcall("test_node2d_set_position", a, Vector2(5, 6), true), Vector2(5, 6))
+	assert_eq(a.position, Vector2(5, 6))
+	assert_eq(s.vmcall("test_node2d_set_position", a, Vector2(7, 8), false), Vector2(5, 6))
+	assert_eq(s.get_exceptions(), 0)
+	assert_eq(a.position, Vector2(5, 6))
+	await Engine.get_main_loop().process_frame
+	assert_eq(a.position, Vector2(7, 8))
+
+	a.queue_free()
+	b.queue_free()
+	c.queue_free()
+	d.queue_free()
+	s.queue_free()
+
+
+func test_method_handles():
+	var s : Sandbox = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+	var n : Node = Node.new()
+
+	var names : int = s.get_interned_name_count()
+	assert_eq(s.vmcall("test_method_handles", n), "Handle")
+	assert_eq(s.get_exceptions(), 0)
+	# The class and the two method names are interned
+	assert_eq(s.get_interned_name_count(), names + 3)
+	# Handles are kept between calls
+	n.name = "Node"
+	assert_eq(s.vmcall("test_method_handles", n), "Handle")
+	assert_eq(s.get_interned_name_count(), names + 3)
+
+	# Handles are bound to the class they were resolved on, and its subclasses
+	var n2 : Node2D = Node2D.new()
+	n2.name = "Node2D"
+	var resource : Resource = Resource.new()
+	resource.resource_name = "Resource"
+	assert_eq(s.vmcall("test_method_handle_class", n, n2), "Node2D")
+	assert_eq(s.get_exceptions(), 0)
+	s.vmcall("test_method_handle_class", n, resource)
+	assert_eq(s.get_exceptions(), 1)
+	n2.queue_free()
+
+	# Methods are still subject to restrictions
+	s.set_method_allowed_callback(func(_sandbox, _obj, method): return method != "set_name")
+	s.vmcall("test_method_handles", n)
+	assert_eq(s.get_exceptions(), 2)
+
+	n.queue_free()
+	s.queue_free()
+
+
+func test_interned_names():
+	var s : Sandbox = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+	var n : Node = Node.new()
+
+	assert_eq(s.vmcall("test_interned_names", n), "Interned 2")
+	assert_eq(s.get_exceptions(), 0)
+	assert_eq(s.get_interned_name_count(), 3)
+	# Interned names are kept between calls
+	assert_eq(s.vmcall("test_interned_names", n), "Interned 2")
+	assert_eq(s.get_interned_name_count(), 3)
+
+	# Interned names are still subject to restrictions
+	s.set_method_allowed_callback(func(_sandbox, _obj, method): return method != "set_name")
+	s.vmcall("test_interned_names", n)
+	assert_eq(s.get_exceptions(), 1)
+
+	n.queue_free()
+	s.queue_free()
+
+
+func test_bulk_containers():
+	var s : Sandbox = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+
+	var array : Array = [1, 2, 3, 4, 5, 6, 7, 8, 9, 10]
+	var result = s.vmcall("test_array_ranges", array)
+	assert_eq(s.get_exceptions(), 0)
+	assert_eq(result.size(), 12)
+	assert_eq(result.slice(0, 10), [2, 4, 6, 8, 10, 12, 14, 16, 18, 20])
+	assert_eq(result[10], "tail")
+	assert_eq(result[11], [])
+
+	var dict : Dictionary = {"a": 1, "b": 2, 3: "c"}
+	assert_eq(s.vmcall("test_dictionary_items", dict), {1: "a", 2: "b", "c": 3})
+	assert_eq(s.get_exceptions(), 0)
+
+	# Copies stop early, instead of failing, when the call runs out of references
+	var many : Dictionary = {}
+	for i in range(s.get_max_refs() * 2):
+		many["key" + str(i)] = i
+	var copied : int = s.vmcall("test_dictionary_keys_limit", many)
+	assert_eq(s.get_exceptions(), 0)
+	assert_gt(copied, 0)
+	assert_lt(copied, s.get_max_refs())
+
+	s.queue_free()
+
+
+func test_call_depth():
+	var s : Sandbox = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+	assert_eq(s.get_max_call_depth(), 8)
+
+	# Guest -> host -> guest chains may nest up to the maximum call depth
+	assert_eq(s.vmcall("test_call_depth", s, 7), 8)
+	assert_eq(s.get_exceptions(), 0)
+	assert_eq(s.get_call_depth(), 0)
+
+	# Deeper chains are configurable at run-time
+	s.call_depth_max = 16
+	assert_eq(s.vmcall("test_call_depth", s, 15), 16)
+	assert_eq(s.get_exceptions(), 0)
+
+	s.call_depth_max = 2
+	s.vmcall("test_call_depth", s, 2)
+	assert_eq(s.get_exceptions(), 1)
+
+	s.queue_free()
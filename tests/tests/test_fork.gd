@@ -0,0 +1,116 @@
+extends GutTest
+
+var Sandbox_TestsTests = load("res://tests/tests.elf")
+
+func test_fork_from():
+	var s1 = Sandbox.new()
+	s1.set_program(Sandbox_TestsTests)
+	assert_eq_deep(s1.vmcallv("test_static_storage", "key", "value"), {"key": "value"})
+
+	# The fork inherits the initialized state of the original sandbox
+	var s2 = Sandbox.new()
+	assert_true(s2.fork_from(s1), "Forking an initialized sandbox should succeed")
+	assert_true(s2.has_program_loaded(), "The fork should have a program loaded")
+	assert_true(s2.has_function("test_static_storage"), "The fork should have the same functions")
+	assert_eq_deep(s2.vmcallv("test_static_storage", "key2", "value2"), {"key": "value", "key2": "value2"})
+
+	# The original sandbox is frozen while it has forks, as they share its pages
+	assert_eq(s1.vmcallv("test_static_storage", "key3", "value3"), null, "Calls into a forked-from sandbox should be refused")
+
+	# Changes made by one fork are not visible to other forks
+	var s3 = Sandbox.new()
+	assert_true(s3.fork_from(s1), "Forking again should succeed")
+	assert_eq_deep(s3.vmcallv("test_static_storage", "key3", "value3"), {"key": "value", "key3": "value3"})
+	assert_eq_deep(s2.vmcallv("test_static_storage", "key4", "value4"), {"key": "value", "key2": "value2", "key4": "value4"})
+
+	# Once its forks are gone, the original sandbox can be called again, with its own state
+	s3.free()
+	s2.reset(true)
+	assert_eq_deep(s1.vmcallv("test_static_storage", "key5", "value5"), {"key": "value", "key5": "value5"})
+
+	# Resetting the original sandbox unloads its forks
+	assert_true(s2.fork_from(s1), "Forking after a reset should succeed")
+	s1.reset(true)
+	assert_false(s2.has_program_loaded(), "The fork should be unloaded with the original")
+
+	s2.queue_free()
+	s1.queue_free()
+
+func test_from_template():
+	var s = Sandbox.FromTemplate(Sandbox_TestsTests)
+	assert_true(s.has_program_loaded(), "A sandbox created from a template should have a program loaded")
+	assert_eq(s.get_program(), Sandbox_TestsTests)
+	assert_eq(s.vmcall("test_int", 1234), 1234)
+	s.queue_free()
+
+func test_sandbox_pool():
+	var pool = SandboxPool.new()
+	pool.program = Sandbox_TestsTests
+
+	var s = pool.acquire()
+	assert_true(s.has_program_loaded(), "Pooled sandboxes should be initialized")
+	assert_eq_deep(s.vmcallv("test_static_storage", "key", "value"), {"key": "value"})
+	pool.release(s)
+	assert_eq(pool.get_idle_count(), 1)
+
+	# The recycled sandbox is rewound to its initialized state
+	var s2 = pool.acquire()
+	assert_eq(s2, s, "The idle sandbox should be handed out again")
+	assert_eq_deep(s2.vmcallv("test_static_storage", "key2", "value2"), {"key2": "value2"})
+	pool.release(s2)
+
+	# Releasing twice is refused, and the instance is only pooled once
+	pool.release(s2)
+	assert_eq(pool.get_idle_count(), 1)
+
+	# Releasing during a VM call is refused, as the call still uses the instance
+	var s3 = pool.acquire()
+	assert_eq(pool.get_idle_count(), 0)
+	var release_during_call = func(a, b, c):
+		pool.release(s3)
+		return pool.get_idle_count()
+	assert_eq(s3.vmcall("test_callable", release_during_call), 0)
+	assert_true(s3.has_program_loaded(), "The instance should not be rewound during the call")
+	pool.release(s3)
+	assert_eq(pool.get_idle_count(), 1)
+
+	pool.clear()
+	assert_eq(pool.get_idle_count(), 0)
+
+func test_vmcall_parallel():
+	var sandboxes = []
+	for i in 4:
+		sandboxes.push_back(Sandbox.FromTemplate(Sandbox_TestsTests))
+
+	var results = Sandbox.vmcall_parallel(sandboxes, "test_int", [1234])
+	assert_eq_deep(results, [1234, 1234, 1234, 1234])
+	for s in sandboxes:
+		assert_eq(s.get_exceptions(), 0)
+
+	# Scene tree access is handled on the main thread
+	var parent = Node.new()
+	parent.add_child(sandboxes[0])
+	results = Sandbox.vmcall_parallel(sandboxes.slice(0, 1), "get_tree_base_parent")
+	assert_eq(results[0], parent)
+
+	# Callables are user script, so they are called on the main thread
+	var callable = func(a, b, c): return OS.get_thread_caller_id()
+	results = Sandbox.vmcall_parallel(sandboxes.slice(1), "test_callable", [callable])
+	for result in results:
+		assert_eq(result, OS.get_main_thread_id(), "Callables should be called on the main thread")
+
+	# Each sandbox gets its own copy of container arguments, which the guest modifies
+	var array : Array = []
+	results = Sandbox.vmcall_parallel(sandboxes, "test_array", [array])
+	for result in results:
+		assert_eq_deep(result, [1, "2", 3.0])
+	assert_eq_deep(array, [])
+	for s in sandboxes:
+		assert_eq(s.get_exceptions(), 0)
+
+	# A sandbox cannot run on two threads at once
+	assert_eq_deep(Sandbox.vmcall_parallel([sandboxes[1], sandboxes[1]], "test_int", [1]), [])
+
+	parent.free()
+	for i in range(1, sandboxes.size()):
+		sandboxes[i].queue_free()
@@ -39,3 +39,66 @@ PUBLIC Variant verify_shm2(float *array, size_t size) {
 
 	return true; // Verification succeeded
 }
+
+PUBLIC Variant test_view_packed_array(PackedArray<float> arr) {
+	std::span<const float> view = arr.view();
+	// Viewing the same array again in the same call gives the same mapping
+	if (view.data() != arr.view().data() || view.size() != arr.size()) {
+		return Nil;
+	}
+	double sum = 0.0;
+	for (float value : view) {
+		sum += value;
+	}
+	return sum;
+}
+
+PUBLIC Variant test_view_packed_vec3_array(PackedArray<Vector3> arr) {
+	std::span<const Vector3> view = arr.view();
+	Vector3 sum;
+	for (const Vector3 &value : view) {
+		sum += value;
+	}
+	return sum;
+}
+
+PUBLIC Variant test_channel_echo(uint64_t input, uint64_t output) {
+	Channel in(input);
+	Channel out(output);
+	char buffer[256];
+	int count = 0;
+	int64_t size;
+	while ((size = in.receive(buffer, sizeof(buffer))) >= 0) {
+		if (!out.send(buffer, size)) {
+			return -1;
+		}
+		count++;
+	}
+	return count;
+}
+
+PUBLIC Variant test_channel_corrupt(uint64_t channel, int field, uint64_t value) {
+	// A misbehaving guest may write anything into the channel header
+	uint8_t *base = reinterpret_cast<uint8_t *>(channel);
+	switch (field) {
+		case 0:
+			*reinterpret_cast<uint32_t *>(base + int(Channel_Layout::CAPACITY)) = value;
+			break;
+		case 1:
+			*reinterpret_cast<uint64_t *>(base + int(Channel_Layout::HEAD)) = value;
+			break;
+		case 2:
+			*reinterpret_cast<uint64_t *>(base + int(Channel_Layout::TAIL)) = value;
+			break;
+		default:
+			// A message length at the start of the ring buffer
+			*reinterpret_cast<uint32_t *>(base + int(Channel_Layout::DATA)) = value;
+			break;
+	}
+	return Nil;
+}
+
+PUBLIC Variant test_shm_write_last(float *array, size_t size, float value) {
+	array[size - 1] = value;
+	return Nil;
+}
@@ -99,3 +99,149 @@ func test_sharing_sandboxes_after_mutation():
 
 	s1.queue_free()
 	s2.queue_free()
+
+func test_packed_array_views():
+	var s = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+	assert_true(s.has_function("test_view_packed_array"), "Sandbox should have the test_view_packed_array function")
+
+	# Small arrays only occupy the copied tail page
+	assert_eq(s.vmcall("test_view_packed_array", PackedFloat32Array([1.0, 2.0, 3.0])), 6.0)
+	assert_eq(s.vmcall("test_view_packed_array", PackedFloat32Array()), 0.0)
+
+	# Large arrays are mapped page by page, and released when each call returns
+	var array = PackedFloat32Array()
+	array.resize(100001)
+	array.fill(1.0)
+	for i in range(10):
+		assert_eq(s.vmcall("test_view_packed_array", array), 100001.0, "The view should see the whole array")
+	assert_eq(array[0], 1.0, "The viewed array should be unchanged")
+
+	var points = PackedVector3Array([Vector3(1, 2, 3), Vector3(4, 5, 6)])
+	assert_eq(s.vmcall("test_view_packed_vec3_array", points), Vector3(5, 7, 9))
+
+	s.queue_free()
+
+func test_channels():
+	var s = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+	assert_true(s.has_function("test_channel_echo"), "Sandbox should have the test_channel_echo function")
+
+	# A small capacity makes the messages wrap around the end of the ring buffer
+	var input = s.open_channel(64)
+	var output = s.open_channel(64)
+	assert_ne(input, 0, "Opening a channel should succeed")
+	assert_ne(output, 0, "Opening a channel should succeed")
+	assert_eq(s.channel_receive(input), null, "A new channel should be empty")
+
+	for i in range(20):
+		var messages = ["Hello", "", "World " + str(i)]
+		for message in messages:
+			assert_true(s.channel_send(input, message.to_utf8_buffer()), "Sending should succeed")
+		# The channels stay mapped between calls
+		assert_eq(s.vmcall("test_channel_echo", input, output), messages.size())
+		for message in messages:
+			assert_eq(s.channel_receive(output).get_string_from_utf8(), message)
+		assert_eq(s.channel_receive(output), null, "All messages should have been received")
+
+	# A full channel refuses new messages, until they are received
+	var sent = 0
+	while s.channel_send(input, PackedByteArray([1, 2, 3, 4])):
+		sent += 1
+	assert_eq(sent, 8, "A 64-byte channel should hold eight 4-byte messages")
+	assert_eq_deep(s.channel_receive(input), PackedByteArray([1, 2, 3, 4]))
+	assert_true(s.channel_send(input, PackedByteArray([5])), "Sending should succeed after receiving")
+
+	assert_true(s.close_channel(input), "Closing the channel should succeed")
+	assert_true(s.close_channel(output), "Closing the channel should succeed")
+	assert_false(s.close_channel(output), "A channel can only be closed once")
+	s.queue_free()
+
+func test_corrupted_channels():
+	var s = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+	assert_true(s.has_function("test_channel_corrupt"), "Sandbox should have the test_channel_corrupt function")
+
+	# The host keeps its own capacity, so a huge one written by the guest is ignored
+	var channel = s.open_channel(64)
+	s.vmcall("test_channel_corrupt", channel, 0, 0xFFFFFFFF)
+	var sent = 0
+	while s.channel_send(channel, PackedByteArray([1, 2, 3, 4])):
+		sent += 1
+	assert_eq(sent, 8, "The capacity written by the guest should be ignored")
+	assert_false(s.channel_send(channel, PackedByteArray()), "A full channel refuses messages")
+	s.close_channel(channel)
+
+	# More pending data than the capacity is rejected by both ends
+	channel = s.open_channel(64)
+	s.vmcall("test_channel_corrupt", channel, 1, 1 << 40)
+	assert_false(s.channel_send(channel, PackedByteArray([1])), "Sending to a corrupted channel should fail")
+	assert_eq(s.channel_receive(channel), null, "Receiving from a corrupted channel should fail")
+	# A tail past the head is the same as a huge amount of pending data
+	s.vmcall("test_channel_corrupt", channel, 1, 0)
+	s.vmcall("test_channel_corrupt", channel, 2, 16)
+	assert_false(s.channel_send(channel, PackedByteArray([1])), "Sending to a corrupted channel should fail")
+	assert_eq(s.channel_receive(channel), null, "Receiving from a corrupted channel should fail")
+	s.close_channel(channel)
+
+	# A message length larger than the pending data is rejected
+	channel = s.open_channel(64)
+	s.vmcall("test_channel_corrupt", channel, 3, 0x7FFFFFFF)
+	s.vmcall("test_channel_corrupt", channel, 1, 8)
+	assert_eq(s.channel_receive(channel), null, "A message longer than the pending data should be rejected")
+	s.vmcall("test_channel_corrupt", channel, 3, 4)
+	assert_eq_deep(s.channel_receive(channel), PackedByteArray([0, 0, 0, 0]), "A valid length is received")
+	s.close_channel(channel)
+	s.queue_free()
+
+func test_shared_memory_reuse():
+	var s = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+
+	var small = PackedFloat32Array([1.0, 2.0, 3.0, 4.0, 5.0])
+	var large = PackedFloat32Array()
+	large.resize(100000)
+
+	# Sharing and unsharing every frame keeps reusing the same addresses
+	var first = s.share_float32_array(true, large)
+	assert_true(s.unshare_array(first), "Unsharing the array should succeed")
+	for i in range(10):
+		var vaddr = s.share_float32_array(true, large)
+		assert_eq(vaddr, first, "The range of an unshared array should be reused")
+		assert_true(s.unshare_array(vaddr), "Unsharing the array should succeed")
+
+	# Freed ranges are merged with their neighbours, and split again when reused
+	var a = s.share_float32_array(true, small)
+	var b = s.share_float32_array(true, small)
+	var c = s.share_float32_array(true, large)
+	assert_true(s.unshare_array(a), "Unsharing the array should succeed")
+	assert_true(s.unshare_array(b), "Unsharing the array should succeed")
+	var d = s.share_float32_array(true, small)
+	assert_eq(d, a, "The first free range should be reused")
+	var e = s.share_float32_array(true, small)
+	assert_eq(e, b, "The rest of the merged range should be reused")
+
+	# Any address inside a shared range finds the range
+	assert_true(s.unshare_array(c + 4096), "Unsharing by an inner address should succeed")
+	assert_true(s.unshare_array(d), "Unsharing the array should succeed")
+	assert_true(s.unshare_array(e), "Unsharing the array should succeed")
+	assert_false(s.unshare_array(e), "An array can only be unshared once")
+	s.queue_free()
+
+func test_shared_memory_padded():
+	var s = Sandbox.new()
+	s.set_program(Sandbox_TestsTests)
+	assert_eq(Sandbox.page_padded_size(5, 4), 1024)
+	assert_eq(Sandbox.page_padded_size(1024, 4), 1024)
+	assert_eq(Sandbox.page_padded_size(1, 12), 1024)
+	assert_eq(Sandbox.page_padded_size(0, 4), 0)
+
+	# An array padded to whole pages is shared without copying its end
+	var array = PackedFloat32Array()
+	array.resize(Sandbox.page_padded_size(100001, 4))
+	var vaddr = s.share_float32_array(true, array)
+	s.vmcall("test_shm_write_last", vaddr, array.size(), 42.0)
+	assert_eq(array[array.size() - 1], 42.0, "Guest writes to the end should be seen before unsharing")
+	assert_true(s.unshare_array(vaddr), "Unsharing the array should succeed")
+	assert_eq(array[array.size() - 1], 42.0)
+	s.queue_free()